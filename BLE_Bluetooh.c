@@ -2,21 +2,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <pthread.h>
 #include "BLE_Bluetooh.h"
+#include "ble_checksum.h"
+#include "ble_trace.h"
+#include "ble_compress.h"
 
 
-// 全局变量：标记是否发现目标设备
-static bool device_found = false;
-// 校验和计算函数
-static uint16_t calculate_checksum(const uint8_t* data, size_t len) {
-    uint16_t sum = 0;
-    for (size_t i = 0; i < len; i++) {
-        sum += data[i];
-    }
-    return sum; // 取低16位作为校验和
-}
-
 // 数据包打印函数
 void print_packet(const uint8_t* data, size_t len) {
     printf("Packet (len: %zu): ", len);
@@ -31,200 +24,368 @@ void print_packet(const uint8_t* data, size_t len) {
 // 构建A0包 (调速)
 // 返回值：构建的数据包长度，0表示失败
 size_t build_a0_packet(ble_cmd_a0_t* a0_data, uint8_t* buffer, size_t buffer_len) {
-    const size_t required_len = 1 + 1 + 2; // cmd(1) + gear(1) + checksum(2)
-    if (buffer_len < required_len) return 0;
-
-    buffer[0] = a0_data->cmd;
-    buffer[1] = a0_data->gear;
-    
-    // 计算校验和
-    uint16_t checksum = calculate_checksum(buffer, 2);
-    a0_data->checksum = checksum;
-    buffer[2] = (checksum >> 8) & 0xFF;  // 高8位
-    buffer[3] = checksum & 0xFF;         // 低8位
-
-    return required_len;
+    return ble_a0_encode(a0_data, buffer, buffer_len);
 }
 
 // 构建A1包 (基础信息)
 size_t build_a1_packet(ble_cmd_a1_t* a1_data, uint8_t* buffer, size_t buffer_len) {
-    const size_t required_len = 1 + 5 + 2; // cmd(1) + 5个u8 + checksum(2)
-    if (buffer_len < required_len) return 0;
+    return ble_a1_encode(a1_data, buffer, buffer_len);
+}
 
-    buffer[0] = a1_data->cmd;
-    buffer[1] = a1_data->play_mode;
-    buffer[2] = a1_data->total_lists;
-    buffer[3] = a1_data->current_list;
-    buffer[4] = a1_data->effect_count;
-    buffer[5] = a1_data->current_effect;
+// 构建A2包 (名称基本)
+size_t build_a2_packet(ble_cmd_a2_t *a2_data, uint8_t* buffer, size_t buffer_len) {
+    return ble_a2_encode(a2_data, buffer, buffer_len);
+}
+
+// 构建A3包 (字节数据)
+size_t build_a3_packet(ble_cmd_a3_t* a3_data, uint8_t* buffer, size_t buffer_len) {
+    if (a3_data->data_len > sizeof(a3_data->data)) return 0;
+    return ble_a3_encode(a3_data, buffer, buffer_len);
+}
+
+// 构建变长A3包：数据段按segment_len编码，末包不再补0
+// 校验和只覆盖实际数据，与固定64字节补0的结果相同
+size_t encode_a3_packet(uint8_t packet_num, const uint8_t* segment, size_t segment_len,
+                        uint8_t* buffer, size_t buffer_len) {
+    const size_t required_len = A3_HEADER_LEN + segment_len + A3_CHECKSUM_LEN;
+    if (buffer_len < required_len || segment == NULL ||
+        segment_len == 0 || segment_len > A3_MAX_SEGMENT) return 0;
+
+    buffer[BLE_OFF(a3, cmd)] = CMD_A3;
+    buffer[BLE_OFF(a3, packet_num)] = packet_num;
+    buffer[BLE_OFF(a3, data_len)] = (uint8_t)segment_len;
+    memcpy(buffer + A3_HEADER_LEN, segment, segment_len);
 
     // 计算校验和
-    uint16_t checksum = calculate_checksum(buffer, 6);
-    a1_data->checksum = checksum;
-    buffer[6] = (checksum >> 8) & 0xFF;
-    buffer[7] = checksum & 0xFF;
+    ble_put_u16(buffer + A3_HEADER_LEN + segment_len, ble_checksum(buffer + A3_HEADER_LEN, segment_len));
 
     return required_len;
 }
 
-// 构建A2包 (名称基本)
-size_t build_a2_packet(ble_cmd_a2_t *a2_data, uint8_t* buffer, size_t buffer_len) {
-    const size_t required_len = 1 + 2 + 1 + 1 + 16 + 2; // 各字段总和
-    if (buffer_len < required_len || !a2_data->type_list) return 0;
-    buffer[0] = a2_data->cmd;
-    buffer[1] = (a2_data->total_bytes >> 8) & 0xFF;  // 总字节数高8位
-    buffer[2] = a2_data->total_bytes & 0xFF;         // 总字节数低8位
-    buffer[3] = a2_data->total_packets;
-    buffer[4] = a2_data->char_len;
-    memcpy(buffer + 5, a2_data->type_list, 16);      // 类型列表
+// 根据ATT MTU计算A3数据段长度
+// 一个A3包正好占满一个ATT写PDU；MTU较小时保持原来的64字节(设备通过长写入接收)
+size_t a3_segment_size(uint16_t mtu) {
+    if (mtu <= ATT_WRITE_HEADER_LEN + A3_HEADER_LEN + A3_CHECKSUM_LEN) {
+        return A3_LEGACY_SEGMENT;
+    }
+    size_t segment = mtu - ATT_WRITE_HEADER_LEN - A3_HEADER_LEN - A3_CHECKSUM_LEN;
+    if (segment < A3_LEGACY_SEGMENT) {
+        return A3_LEGACY_SEGMENT;
+    }
+    return (segment > A3_MAX_SEGMENT) ? A3_MAX_SEGMENT : segment;
+}
 
-    // 计算校验和
-    uint16_t checksum = calculate_checksum(buffer, 4 + 16);
-    a2_data->checksum = checksum;
-    buffer[21] = (checksum >> 8) & 0xFF;    // 5+16=21
-    buffer[22] = checksum & 0xFF;
+// 无响应写入时的A3数据段长度
+// Write Command没有长写入，整个A3包必须放进一个ATT PDU
+size_t a3_pdu_segment_size(uint16_t mtu) {
+    if (mtu < ATT_DEFAULT_LE_MTU) {
+        mtu = ATT_DEFAULT_LE_MTU;
+    }
+    size_t segment = mtu - ATT_WRITE_HEADER_LEN - A3_HEADER_LEN - A3_CHECKSUM_LEN;
+    return (segment > A3_MAX_SEGMENT) ? A3_MAX_SEGMENT : segment;
+}
 
-    return required_len;
+// 计算数据按segment_size分包后的A3包数，超过255包时返回0
+uint8_t a3_packet_count(size_t data_len, size_t segment_size) {
+    if (segment_size == 0) return 0;
+    size_t count = (data_len + segment_size - 1) / segment_size;
+    return (count > 255) ? 0 : (uint8_t)count;
 }
 
-// 构建A3包 (字节数据)
-size_t build_a3_packet(ble_cmd_a3_t* a3_data, uint8_t* buffer, size_t buffer_len) {
-    const size_t required_len = 1 + 1 + 1 + 64 + 2; // 各字段总和
-    if (buffer_len < required_len || !a3_data->data || a3_data->data_len > 64) return 0;
+// gattlib传输：带响应写入，句柄已解析时直接按句柄写入，不再查找特征
+static int gattlib_transport_write_req(ble_session_t* session, const uint8_t* data, size_t len) {
+    if (session->connection == NULL) {
+        printf("错误：连接为空\n");
+        return GATTLIB_INVALID_PARAMETER;
+    }
+    if (session->char_handle != 0) {
+        return gattlib_write_char_by_handle(session->connection, session->char_handle, data, len);
+    }
+    return gattlib_write_char_by_uuid(session->connection, &session->char_uuid, data, len);
+}
+
+static int gattlib_transport_write_cmd(ble_session_t* session, const uint8_t* data, size_t len) {
+    if (session->char_handle != 0) {
+        return gattlib_write_without_response_char_by_handle(session->connection, session->char_handle, data, len);
+    }
+    return gattlib_write_without_response_char_by_uuid(session->connection, &session->char_uuid, data, len);
+}
 
-    buffer[0] = a3_data->cmd;
-    buffer[1] = a3_data->packet_num;
-    buffer[2] = a3_data->data_len;
-    memcpy(buffer + 3, a3_data->data, 64);  // 数据段(固定64字节)
+static int gattlib_transport_stream_open(ble_session_t* session, gattlib_stream_t** stream, uint16_t* mtu) {
+    return gattlib_write_char_by_uuid_stream_open(session->connection, &session->char_uuid, stream, mtu);
+}
 
-    // 计算校验和
-    uint16_t checksum = calculate_checksum(buffer + 3, 64);
-    a3_data->data_checksum = checksum;
-    buffer[67] = (checksum >> 8) & 0xFF;    // 3+64=67
-    buffer[68] = checksum & 0xFF;
+static int gattlib_transport_stream_write(ble_session_t* session, gattlib_stream_t* stream,
+                                          const uint8_t* data, size_t len) {
+    return gattlib_write_char_stream_write(stream, data, len);
+}
 
-    return required_len;
+static int gattlib_transport_stream_close(ble_session_t* session, gattlib_stream_t* stream) {
+    return gattlib_write_char_stream_close(stream);
 }
 
-// 通知回调函数 (接收设备反馈)
-static void notification_callback(const uuid_t* uuid, const uint8_t* data, 
-                                 size_t data_length, void* user_data) {
-    char uuid_str[37];
-    char temp[37];
-    gattlib_uuid_to_string(uuid, uuid_str, sizeof(uuid_str));
-    
-    printf("收到通知: UUID=%s, 长度=%zu\n", uuid_str, data_length);
-    
-    // 打印完整数据用于调试
-    if (data_length > 0) {
-        printf("数据内容: ");
-        for (size_t i = 0; i < data_length; i++) {
-            printf("%02X ", data[i]);
-        }
-        printf("\n");
-    }
-    printf("uuid_str: %s strlen : %d \n", uuid_str, (int)strlen(uuid_str));
-    for (size_t i = 0; i < strlen(uuid_str); i++) {
-        printf("char %zu : %c (0x%02X)\n", i, uuid_str[i], (uint8_t)uuid_str[i]);
-    }
-    memcpy(temp, NOTIFY_UUID, sizeof(NOTIFY_UUID));
-    printf("NOTIFY_UUID: %s strlen : %d \n", NOTIFY_UUID, (int)strlen(NOTIFY_UUID));
-    printf("temp: %s strlen : %d \n", temp, (int)strlen(temp));
-    for (size_t i = 0; i < strlen(temp); i++) {
-        printf("char %zu : %c (0x%02X)\n", i, temp[i], (uint8_t)temp[i]);
-    }
-    if (strcmp(uuid_str, NOTIFY_UUID) == 0) {
-        pthread_mutex_lock(&m_state.lock);
-        if (data_length >= 1) {
-            if (data[0] == 0x01) {
-                printf("收到成功反馈 (0x01)\n");
-                m_state.last_send_success = true;
-            } else if (data[0] == 0x00) {
-                printf("收到失败反馈 (0x00)\n");
-                m_state.last_send_success = false;
-            } else {
-                printf("收到未知反馈: 0x%02X\n", data[0]);
-                // 从gattool日志看，设备可能发送的是0x01
-                // 但您的协议可能定义不同
-                m_state.last_send_success = (data[0] == 0x01);
+const ble_transport_ops_t ble_gattlib_transport = {
+    .write_req = gattlib_transport_write_req,
+    .write_cmd = gattlib_transport_write_cmd,
+    .stream_open = gattlib_transport_stream_open,
+    .stream_write = gattlib_transport_stream_write,
+    .stream_close = gattlib_transport_stream_close,
+};
+
+// 获取连接的ATT MTU
+// gattlib没有单独的MTU接口，借用AcquireWrite返回的MTU，取到后立即关闭
+// (持有AcquireWrite期间BlueZ会拒绝普通写操作)
+uint16_t query_connection_mtu(ble_session_t* session) {
+    gattlib_stream_t* stream = NULL;
+    uint16_t mtu = 0;
+
+    int ret = session->transport_ops->stream_open(session, &stream, &mtu);
+    if (ret != GATTLIB_SUCCESS) {
+        printf("无法获取MTU (错误码: %d)，使用默认分包长度\n", ret);
+        return 0;
+    }
+    session->transport_ops->stream_close(session, stream);
+    return mtu;
+}
+
+// 从since(CLOCK_MONOTONIC)到现在经过的微秒数
+static long elapsed_us(const struct timespec* since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000000L + (now.tv_nsec - since->tv_nsec) / 1000;
+}
+
+static long clamp_rto_ms(long rto_ms) {
+    if (rto_ms < RTO_MIN_MS) return RTO_MIN_MS;
+    if (rto_ms > RTO_MAX_MS) return RTO_MAX_MS;
+    return rto_ms;
+}
+
+// RTT估计初始化：没有样本前使用FEEDBACK_TIMEOUT_MS
+static void rtt_init(ble_rtt_t* rtt) {
+    rtt->has_sample = false;
+    rtt->srtt_us = 0;
+    rtt->rttvar_us = 0;
+    rtt->rto_ms = FEEDBACK_TIMEOUT_MS;
+}
+
+// 加入一个RTT样本 (RFC 6298 第2节，alpha=1/8，beta=1/4)
+// 调用者需保证样本来自未重发过的帧 (Karn算法)
+static void rtt_update(ble_rtt_t* rtt, long sample_us) {
+    if (sample_us < 0) {
+        return;
+    }
+    if (!rtt->has_sample) {
+        rtt->srtt_us = sample_us;
+        rtt->rttvar_us = sample_us / 2;
+        rtt->has_sample = true;
+    } else {
+        long delta = rtt->srtt_us - sample_us;
+        rtt->rttvar_us = (3 * rtt->rttvar_us + (delta < 0 ? -delta : delta)) / 4;
+        rtt->srtt_us = (7 * rtt->srtt_us + sample_us) / 8;
+    }
+    // 新样本同时清除之前的退避
+    rtt->rto_ms = clamp_rto_ms((rtt->srtt_us + 4 * rtt->rttvar_us + 999) / 1000);
+}
+
+// 反馈超时：超时时间加倍 (RFC 6298 5.5)
+static void rtt_backoff(ble_rtt_t* rtt) {
+    rtt->rto_ms = clamp_rto_ms(rtt->rto_ms * 2);
+}
+
+// 初始化会话，配置从m_config复制
+void ble_session_init(ble_session_t* session, const char* mac_address) {
+    memset(session, 0, sizeof(*session));
+    session->mac_address = mac_address;
+    session->char_uuid = m_config.char_uuid;
+    session->notify_uuid = m_config.notify_uuid;
+    session->a3_transport = m_config.a3_transport;
+    session->compress = m_config.compress;
+    session->delta = m_config.delta;
+    session->transport_ops = &ble_gattlib_transport;
+    session->window_size = A3_WINDOW_SIZE;
+    rtt_init(&session->rtt);
+    ble_delta_cache_init(&session->delta_cache);
+    pthread_mutex_init(&session->lock, NULL);
+    pthread_cond_init(&session->cond, NULL);
+}
+
+// 释放会话资源
+void ble_session_destroy(ble_session_t* session) {
+    ble_delta_cache_free(&session->delta_cache);
+    pthread_mutex_destroy(&session->lock);
+    pthread_cond_destroy(&session->cond);
+}
+
+// 从帧环中取一个空闲帧槽，没有空闲槽时返回NULL
+ble_frame_t* frame_arena_acquire(ble_frame_arena_t* arena) {
+    for (unsigned int i = 0; i < FRAME_ARENA_SLOTS; i++) {
+        ble_frame_t* frame = &arena->slots[(arena->next + i) % FRAME_ARENA_SLOTS];
+        if (!frame->in_use) {
+            arena->next = (arena->next + i + 1) % FRAME_ARENA_SLOTS;
+            frame->in_use = true;
+            frame->len = 0;
+            return frame;
+        }
+    }
+    return NULL;
+}
+
+// 归还帧槽
+void frame_arena_release(ble_frame_t* frame) {
+    if (frame) {
+        frame->in_use = false;
+    }
+}
+
+// 计算从现在起ms毫秒后的绝对时间 (用于pthread_cond_timedwait)
+static void deadline_after_ms(struct timespec* ts, long ms) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static bool timespec_before(const struct timespec* a, const struct timespec* b) {
+    return (a->tv_sec < b->tv_sec) ||
+           (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+// 处理滑动窗口模式下的反馈 (调用者需持有session->lock)
+// 反馈格式: data[0] 为结果(0x01成功/0x00失败)，data[1] 为A3包序号(可选)
+static void handle_window_feedback(ble_session_t* session, const uint8_t* data, size_t data_length) {
+    int packet_num = -1;
+    ble_reply_t reply;
+    int fields = ble_reply_decode(data, data_length, &reply);
+
+    if (fields == 0) {
+        BLE_TRACE_ERROR(BLE_TRACE_FEEDBACK_EMPTY, session->mac_address, 0, 0, NULL, 0);
+        return;
+    }
+
+    if (fields >= 2) {
+        // 带包序号的反馈只匹配该包；超时重发后原包和重发包的反馈都会到达，
+        // 迟到或重复的反馈不能确认其他包
+        if (session->window_state[reply.packet_num] == A3_PKT_IN_FLIGHT) {
+            packet_num = reply.packet_num;
+        }
+    } else {
+        // 反馈不带包序号：按发送顺序匹配最早在途的包
+        uint32_t oldest_seq = UINT32_MAX;
+        for (int i = 1; i < 256; i++) {
+            if (session->window_state[i] == A3_PKT_IN_FLIGHT && session->window_send_seq[i] < oldest_seq) {
+                oldest_seq = session->window_send_seq[i];
+                packet_num = i;
             }
+        }
+    }
+
+    if (packet_num < 0) {
+        BLE_TRACE_INFO(BLE_TRACE_WINDOW_UNMATCHED, session->mac_address, reply.result, fields >= 2 ? reply.packet_num : 0, NULL, 0);
+        return;
+    }
+
+    // 只对发送过一次的包采样，重发包无法区分反馈对应哪一次发送 (Karn算法)
+    if (session->window_send_count[packet_num] == 1) {
+        rtt_update(&session->rtt, elapsed_us(&session->window_sent_at[packet_num]));
+    }
+
+    if (reply.result == BLE_REPLY_OK) {
+        BLE_TRACE_DEBUG(BLE_TRACE_WINDOW_ACK, session->mac_address, packet_num, 0, NULL, 0);
+        session->window_state[packet_num] = A3_PKT_ACKED;
+    } else {
+        BLE_TRACE_INFO(BLE_TRACE_WINDOW_NAK, session->mac_address, packet_num, reply.result, NULL, 0);
+        session->window_state[packet_num] = A3_PKT_NAKED;
+    }
+}
+
+// 处理设备反馈，gattlib通知和模拟设备都从这里进入
+void ble_session_on_feedback(ble_session_t* session, const uint8_t* data, size_t data_length) {
+    ble_reply_t reply;
+
+    pthread_mutex_lock(&session->lock);
+    session->feedback_received = true;
+    if (session->window_active) {
+        handle_window_feedback(session, data, data_length);
+    } else if (ble_reply_decode(data, data_length, &reply) > 0) {
+        // 0x01成功，0x00及其他未知反馈码按失败处理
+        if (reply.result == BLE_REPLY_OK) {
+            BLE_TRACE_DEBUG(BLE_TRACE_FEEDBACK, session->mac_address, reply.result, 0, NULL, 0);
         } else {
-            printf("收到无效反馈数据（空）\n");
-            m_state.last_send_success = false;
+            BLE_TRACE_INFO(BLE_TRACE_FEEDBACK, session->mac_address, reply.result, 0, NULL, 0);
         }
-        pthread_cond_signal(&m_state.cond);
-        pthread_mutex_unlock(&m_state.lock);
+        session->last_send_success = (reply.result == BLE_REPLY_OK);
+        session->last_send_rejected = (reply.result != BLE_REPLY_OK);
     } else {
-        printf("收到非目标UUID的通知, uuid_str : %s\n", uuid_str);
+        BLE_TRACE_ERROR(BLE_TRACE_FEEDBACK_EMPTY, session->mac_address, 0, 0, NULL, 0);
+        session->last_send_success = false;
     }
+    // 发送线程和等待flush的线程共用cond，必须唤醒全部
+    pthread_cond_broadcast(&session->cond);
+    pthread_mutex_unlock(&session->lock);
 }
 
 // 带重发机制的数据包发送函数
-bool send_packet_with_retry(gattlib_connection_t* connection, 
-                                  const uint8_t* data, size_t len) {
+bool send_packet_with_retry(ble_session_t* session, const uint8_t* data, size_t len) {
     int retries = 0;
     while (retries < MAX_RETRIES) {
         printf("发送数据包 (第%d次尝试):\n", retries + 1);
         print_packet(data, len);
-        // 调试：检查连接状态
-        if (connection == NULL) {
-            printf("错误：连接为空\n");
-            return false;
-        }
+
+        // 写入前开始等待，反馈可能在写操作返回前到达
+        struct timespec sent_at;
+        pthread_mutex_lock(&session->lock);
+        session->waiting_feedback = true;
+        session->feedback_received = false;
+        session->last_send_success = false;
+        session->last_send_rejected = false;
+        pthread_mutex_unlock(&session->lock);
+        clock_gettime(CLOCK_MONOTONIC, &sent_at);
 
         // 发送数据
-        int ret = gattlib_write_char_by_uuid(connection, &m_config.char_uuid, data, len);
+        int ret = session->transport_ops->write_req(session, data, len);
         if (ret != 0) {
-            printf("发送失败 (错误码: %d)\n", ret);
-            
-            // 尝试使用句柄发送（从gattool日志看句柄是0x0023）
-            printf("尝试使用句柄发送...\n");
-            ret = gattlib_write_char_by_handle(connection, 0x0023, data, len);
-            if (ret != 0) {
-                printf("句柄发送也失败 (错误码: %d)\n", ret);
-                retries++;
-                continue;
-            } else {
-                printf("使用句柄发送成功\n");
+            // 写入失败不会有反馈，每个提前退出的分支都要结束等待状态
+            pthread_mutex_lock(&session->lock);
+            session->waiting_feedback = false;
+            pthread_mutex_unlock(&session->lock);
+            if (ret == GATTLIB_INVALID_PARAMETER) {
+                return false;
             }
-        } else {
-            printf("使用UUID发送成功\n");
+            printf("发送失败 (错误码: %d)\n", ret);
+            retries++;
+            continue;
         }
-        // 等待反馈
-        pthread_mutex_lock(&m_state.lock);
-        m_state.waiting_feedback = true;
-        m_state.last_send_success = false;
-        
-        // 缓存当前包用于重发
-        free(m_state.last_packet);
-        m_state.last_packet = malloc(len);
-        if (m_state.last_packet) {
-            memcpy(m_state.last_packet, data, len);
-            m_state.last_packet_len = len;
+        // 等待反馈，超时时间由RTT估计得出
+        pthread_mutex_lock(&session->lock);
+        struct timespec ts;
+        deadline_after_ms(&ts, session->rtt.rto_ms);
+
+        int cond_ret = 0;
+        while (!session->feedback_received && cond_ret != ETIMEDOUT) {
+            cond_ret = pthread_cond_timedwait(&session->cond, &session->lock, &ts);
         }
+        bool received = session->feedback_received;
+        session->waiting_feedback = false;
+        bool success = session->last_send_success;
+        if (received && retries == 0) {
+            // 只对首次发送采样 (Karn算法)
+            rtt_update(&session->rtt, elapsed_us(&sent_at));
+        } else if (!received) {
+            rtt_backoff(&session->rtt);
+        }
+        long rto_ms = session->rtt.rto_ms;
+        pthread_mutex_unlock(&session->lock);
 
-        // 设置超时
-        struct timespec ts;
-        clock_gettime(CLOCK_REALTIME, &ts);
-        ts.tv_sec += FEEDBACK_TIMEOUT_MS / 1000;
-        ts.tv_nsec += (FEEDBACK_TIMEOUT_MS % 1000) * 1000000;
-        if (ts.tv_nsec >= 1000000000) {
-            ts.tv_sec++;
-            ts.tv_nsec -= 1000000000;
-        }
-
-        // 等待反馈
-        int cond_ret = pthread_cond_timedwait(&m_state.cond, &m_state.lock, &ts);
-        m_state.waiting_feedback = false;
-        bool success = m_state.last_send_success;
-        pthread_mutex_unlock(&m_state.lock);
-
-        if (cond_ret == ETIMEDOUT) {
-            printf("等待反馈超时\n");
+        if (!received) {
+            printf("等待反馈超时 (下次超时: %ldms)\n", rto_ms);
             retries++;
         } else if (success) {
             printf("数据包发送成功\n");
-            m_state.success_count++;
+            session->success_count++;
             return true;
         } else {
             printf("数据包发送失败，准备重发\n");
@@ -233,90 +394,657 @@ bool send_packet_with_retry(gattlib_connection_t* connection,
     }
 
     printf("达到最大重发次数，发送失败\n");
-    m_state.fail_count++;
+    session->fail_count++;
     return false;
 }
 
+// 带重发机制的帧槽发送函数
+bool send_frame_with_retry(ble_session_t* session, const ble_frame_t* frame) {
+    if (frame == NULL || frame->len == 0) {
+        fprintf(stderr, "无效的帧槽\n");
+        return false;
+    }
+    return send_packet_with_retry(session, frame->data, frame->len);
+}
+
+// 控制帧队列是否非空 (调用者需持有session->lock)
+static bool control_pending(const ble_session_t* session) {
+    return session->gear_pending || session->a1_count > 0;
+}
+
+// 发出所有排队的控制帧，A0调速优先于A1
+// 只在发送线程中、且没有A3包在途时调用，保证反馈不会与A3混淆
+static void service_control_queue(ble_session_t* session) {
+    for (;;) {
+        ble_frame_t* frame;
+        bool is_a0;
+        ble_cmd_a0_t a0_data = { .cmd = CMD_A0 };
+        ble_cmd_a1_t a1_data = { .cmd = CMD_A1 };
+
+        pthread_mutex_lock(&session->lock);
+        if (session->gear_pending) {
+            a0_data.gear = session->gear;
+            session->gear_pending = false;
+            is_a0 = true;
+        } else if (session->a1_count > 0) {
+            a1_data = session->a1_queue[session->a1_head];
+            session->a1_head = (session->a1_head + 1) % CONTROL_QUEUE_LEN;
+            session->a1_count--;
+            is_a0 = false;
+        } else {
+            pthread_mutex_unlock(&session->lock);
+            return;
+        }
+        pthread_mutex_unlock(&session->lock);
+
+        frame = frame_arena_acquire(&session->arena);
+        if (frame == NULL) {
+            fprintf(stderr, "没有空闲帧槽\n");
+            return;
+        }
+        if (is_a0) {
+            printf("[%s] 发送A0包 (档位%d)\n", session->mac_address, a0_data.gear);
+            frame->len = build_a0_packet(&a0_data, frame->data, sizeof(frame->data));
+        } else {
+            printf("[%s] 发送A1包\n", session->mac_address);
+            frame->len = build_a1_packet(&a1_data, frame->data, sizeof(frame->data));
+        }
+        if (frame->len > 0) {
+            send_frame_with_retry(session, frame);
+        }
+        frame_arena_release(frame);
+    }
+}
+
 // 发送A2+A3组合数据包
-bool send_a2_a3_combination(gattlib_connection_t* connection, ble_cmd_a2_t *a2_data, 
+bool send_a2_a3_combination(ble_session_t* session, ble_cmd_a2_t *a2_data, 
                                     ble_cmd_a3_t *a3_data, const uint8_t* data, size_t data_len)
 {
+    bool result = false;
+
+    // 包数由调用者填写，必须与数据长度一致，否则中间的A3包也会越界读取
+    if (a2_data->total_packets == 0 ||
+        a2_data->total_packets != a3_packet_count(data_len, A3_LEGACY_SEGMENT)) {
+        fprintf(stderr, "A3包数 %d 与数据长度 %zu 不一致\n", a2_data->total_packets, data_len);
+        return false;
+    }
+
+    ble_frame_t* frame = frame_arena_acquire(&session->arena);
+    if (frame == NULL) {
+        fprintf(stderr, "没有空闲帧槽\n");
+        return false;
+    }
+
     // 构建并发送A2包
-    uint8_t a2_buffer[23]; // 足够容纳A2包
-    size_t a2_len = build_a2_packet(a2_data, a2_buffer, sizeof(a2_buffer));
-    if (a2_len == 0) {
+    frame->len = build_a2_packet(a2_data, frame->data, sizeof(frame->data));
+    if (frame->len == 0) {
         fprintf(stderr, "构建A2包失败\n");
-        return false;
+        goto EXIT;
     }
 
-    if (!send_packet_with_retry(connection, a2_buffer, a2_len)) {
+    if (!send_frame_with_retry(session, frame)) {
         fprintf(stderr, "A2包发送失败\n");
-        return false;
+        goto EXIT;
     }
 
-    // 发送A3包序列
+    // 发送A3包序列 (复用同一个帧槽)，每包之间插入排队的控制帧
     for (uint8_t i = 0; i < a2_data->total_packets; i++) {
-        uint8_t a3_buffer[70]; // 足够容纳A3包
+        service_control_queue(session);
+
         size_t current_len = (i == a2_data->total_packets - 1) ? 
                             (data_len % 64 ? data_len % 64 : 64) : 64;
         
         a3_data->cmd = CMD_A3;
         a3_data->packet_num = i + 1;
         a3_data->data_len = current_len;
-        memcpy(a3_data->data, data + i * 64, 64);
+        // 末包只拷贝剩余数据，其余补0，不越界读取调用者的缓冲区
+        memcpy(a3_data->data, data + i * 64, current_len);
+        memset(a3_data->data + current_len, 0, sizeof(a3_data->data) - current_len);
         // 构建A3包
-        size_t a3_len = build_a3_packet(a3_data, a3_buffer, sizeof(a3_buffer));
-        if (a3_len == 0) {
+        frame->len = build_a3_packet(a3_data, frame->data, sizeof(frame->data));
+        if (frame->len == 0) {
             fprintf(stderr, "构建A3包 %d 失败\n", i + 1);
-            return false;
+            goto EXIT;
         }
 
         // 发送A3包
-        if (!send_packet_with_retry(connection, a3_buffer, a3_len)) {
+        if (!send_frame_with_retry(session, frame)) {
             fprintf(stderr, "A3包 %d 发送失败\n", i + 1);
-            return false;
+            goto EXIT;
+        }
+    }
+    result = true;
+
+EXIT:
+    frame_arena_release(frame);
+    return result;
+}
+
+// 按发送方式写入一个A3帧
+// 无响应写入失败时(特征不支持Write Command等)退回带响应写入，并修改*transport
+static int write_a3_frame(ble_session_t* session, a3_transport_t* transport,
+                          gattlib_stream_t* stream, const ble_frame_t* frame) {
+    const ble_transport_ops_t* ops = session->transport_ops;
+    int ret;
+
+    if (*transport == A3_TRANSPORT_STREAM) {
+        // 流仍被持有，BlueZ会拒绝普通写入，失败时不退回，按失败包重发
+        return ops->stream_write(session, stream, frame->data, frame->len);
+    }
+
+    if (*transport == A3_TRANSPORT_WRITE_CMD) {
+        ret = ops->write_cmd(session, frame->data, frame->len);
+        if (ret == GATTLIB_SUCCESS) {
+            return ret;
+        }
+        printf("无响应写入失败 (错误码: %d)，改用带响应写入\n", ret);
+        *transport = A3_TRANSPORT_WRITE_REQ;
+    }
+
+    return ops->write_req(session, frame->data, frame->len);
+}
+
+// 滑动窗口方式发送A2+A3组合数据包
+bool send_a2_a3_windowed(ble_session_t* session, ble_cmd_a2_t *a2_data,
+                         const uint8_t* data, size_t data_len, uint8_t window_size,
+                         size_t segment_size, a3_transport_t transport)
+{
+    uint8_t total;
+    gattlib_stream_t* stream = NULL;
+    struct timespec deadline[256];      // 每个在途包的反馈截止时间
+    ble_frame_t* frames[256] = {NULL};  // 每个包占用的帧槽，重发时原地引用
+    uint8_t next = 1;                   // 下一个从未发送过的包序号
+    bool result = false;
+
+    session->a2_rejected = false;
+    if (window_size == 0) {
+        window_size = 1;
+    } else if (window_size > A3_WINDOW_MAX) {
+        window_size = A3_WINDOW_MAX;
+    }
+
+    if (segment_size == 0 || segment_size > A3_MAX_SEGMENT) {
+        segment_size = A3_LEGACY_SEGMENT;
+    }
+
+    // 总包数由数据长度和分包长度决定
+    total = a3_packet_count(data_len, segment_size);
+    if (total == 0 || data_len > UINT16_MAX) {
+        fprintf(stderr, "数据长度无效: %zu\n", data_len);
+        return false;
+    }
+    a2_data->total_bytes = (uint16_t)data_len;
+    a2_data->total_packets = total;
+
+    // A2包头仍然逐包确认
+    ble_frame_t* a2_frame = frame_arena_acquire(&session->arena);
+    if (a2_frame == NULL) {
+        fprintf(stderr, "没有空闲帧槽\n");
+        return false;
+    }
+    a2_frame->len = build_a2_packet(a2_data, a2_frame->data, sizeof(a2_frame->data));
+    if (a2_frame->len == 0) {
+        fprintf(stderr, "构建A2包失败\n");
+        frame_arena_release(a2_frame);
+        return false;
+    }
+    bool a2_sent = send_frame_with_retry(session, a2_frame);
+    frame_arena_release(a2_frame);
+    if (!a2_sent) {
+        fprintf(stderr, "A2包发送失败\n");
+        // 只有设备明确回复失败才算拒绝带标志的A2；写入失败、反馈超时或断开按普通失败处理，
+        // 否则一次链路抖动就会永久关闭压缩和差分
+        pthread_mutex_lock(&session->lock);
+        session->a2_rejected = session->last_send_rejected;
+        pthread_mutex_unlock(&session->lock);
+        return false;
+    }
+
+    // A2发送完成后再打开流：持有AcquireWrite期间BlueZ拒绝普通写入
+    if (transport == A3_TRANSPORT_STREAM) {
+        uint16_t mtu = 0;
+        int ret = session->transport_ops->stream_open(session, &stream, &mtu);
+        if (ret != GATTLIB_SUCCESS) {
+            printf("无法打开写入流 (错误码: %d)，改用无响应写入\n", ret);
+            transport = A3_TRANSPORT_WRITE_CMD;
+        } else if (mtu <= ATT_WRITE_HEADER_LEN ||
+                   A3_HEADER_LEN + segment_size + A3_CHECKSUM_LEN > (size_t)(mtu - ATT_WRITE_HEADER_LEN)) {
+            // 先排除过小的MTU，否则相减下溢成很大的数据段
+            printf("A3包超过流的MTU(%u)，改用带响应写入\n", mtu);
+            session->transport_ops->stream_close(session, stream);
+            transport = A3_TRANSPORT_WRITE_REQ;
+        }
+    }
+
+    pthread_mutex_lock(&session->lock);
+    memset(session->window_state, A3_PKT_PENDING, sizeof(session->window_state));
+    memset(session->window_send_count, 0, sizeof(session->window_send_count));
+    session->window_seq = 0;
+    session->window_active = true;
+    pthread_mutex_unlock(&session->lock);
+
+    printf("滑动窗口发送 %d 个A3包 (窗口大小: %d, 发送方式: %d)\n", total, window_size, transport);
+
+    for (;;) {
+        // 1. 填满窗口：优先选择性重发失败的包，其次发送新包
+        for (;;) {
+            int in_flight = 0;
+            int acked = 0;
+            int packet_num = 0;
+
+            pthread_mutex_lock(&session->lock);
+            for (int i = 1; i <= total; i++) {
+                if (session->window_state[i] == A3_PKT_IN_FLIGHT) {
+                    in_flight++;
+                } else if (session->window_state[i] == A3_PKT_ACKED) {
+                    acked++;
+                    // 已确认的包不会再重发，尽早归还帧槽
+                    frame_arena_release(frames[i]);
+                    frames[i] = NULL;
+                } else if (session->window_state[i] == A3_PKT_NAKED && packet_num == 0) {
+                    packet_num = i;
+                }
+            }
+            if (packet_num == 0 && next <= total) {
+                packet_num = next;
+            }
+            if (acked == total) {
+                pthread_mutex_unlock(&session->lock);
+                result = true;
+                goto EXIT;
+            }
+            // 有控制帧排队时停止发新包，等在途包全部反馈后插入控制帧
+            // 控制帧按逐包确认发送，期间暂停窗口反馈匹配
+            bool has_control = control_pending(session);
+            if (has_control && in_flight == 0) {
+                session->window_active = false;
+                pthread_mutex_unlock(&session->lock);
+                service_control_queue(session);
+                pthread_mutex_lock(&session->lock);
+                session->window_active = true;
+                pthread_mutex_unlock(&session->lock);
+                continue;
+            }
+            if (in_flight >= window_size || packet_num == 0 || has_control) {
+                pthread_mutex_unlock(&session->lock);
+                break;
+            }
+            if (session->window_send_count[packet_num] >= MAX_RETRIES) {
+                pthread_mutex_unlock(&session->lock);
+                fprintf(stderr, "A3包 %d 达到最大重发次数，发送失败\n", packet_num);
+                goto EXIT;
+            }
+            // 先标记在途再写入，避免反馈早于写操作返回
+            session->window_state[packet_num] = A3_PKT_IN_FLIGHT;
+            session->window_send_seq[packet_num] = session->window_seq++;
+            session->window_send_count[packet_num]++;
+            clock_gettime(CLOCK_MONOTONIC, &session->window_sent_at[packet_num]);
+            deadline_after_ms(&deadline[packet_num], session->rtt.rto_ms);
+            uint8_t send_count = session->window_send_count[packet_num];
+            pthread_mutex_unlock(&session->lock);
+
+            // 首次发送时编码进帧槽，重发直接使用槽内已编码的帧
+            ble_frame_t* frame = frames[packet_num];
+            if (frame == NULL) {
+                size_t offset = (size_t)(packet_num - 1) * segment_size;
+                size_t current_len = (data_len - offset < segment_size) ? data_len - offset : segment_size;
+
+                frame = frame_arena_acquire(&session->arena);
+                if (frame == NULL) {
+                    fprintf(stderr, "没有空闲帧槽\n");
+                    goto EXIT;
+                }
+                frames[packet_num] = frame;
+                frame->len = encode_a3_packet(packet_num, data + offset, current_len,
+                                              frame->data, sizeof(frame->data));
+                if (frame->len == 0) {
+                    fprintf(stderr, "构建A3包 %d 失败\n", packet_num);
+                    goto EXIT;
+                }
+            }
+
+            if (packet_num == next) {
+                next++;
+            }
+            printf("发送A3包 %d (第%d次)\n", packet_num, send_count);
+
+            int ret = write_a3_frame(session, &transport, stream, frame);
+            if (ret != 0) {
+                printf("A3包 %d 写入失败 (错误码: %d)\n", packet_num, ret);
+                pthread_mutex_lock(&session->lock);
+                if (session->window_state[packet_num] == A3_PKT_IN_FLIGHT) {
+                    session->window_state[packet_num] = A3_PKT_NAKED;
+                }
+                pthread_mutex_unlock(&session->lock);
+            }
+        }
+
+        // 2. 等待反馈，最多等到最早在途包的截止时间
+        pthread_mutex_lock(&session->lock);
+        struct timespec earliest;
+        bool has_in_flight = false;
+        for (int i = 1; i <= total; i++) {
+            if (session->window_state[i] == A3_PKT_IN_FLIGHT &&
+                (!has_in_flight || timespec_before(&deadline[i], &earliest))) {
+                earliest = deadline[i];
+                has_in_flight = true;
+            }
+        }
+        if (has_in_flight) {
+            pthread_cond_timedwait(&session->cond, &session->lock, &earliest);
+        }
+
+        // 3. 超时未反馈的包标记为失败，等待选择性重发
+        // 一轮等待中有包超时只退避一次
+        struct timespec now;
+        bool timed_out = false;
+        clock_gettime(CLOCK_REALTIME, &now);
+        for (int i = 1; i <= total; i++) {
+            if (session->window_state[i] == A3_PKT_IN_FLIGHT && !timespec_before(&now, &deadline[i])) {
+                printf("A3包 %d 等待反馈超时\n", i);
+                session->window_state[i] = A3_PKT_NAKED;
+                timed_out = true;
+            }
+        }
+        if (timed_out) {
+            rtt_backoff(&session->rtt);
+        }
+        pthread_mutex_unlock(&session->lock);
+    }
+
+EXIT:
+    pthread_mutex_lock(&session->lock);
+    session->window_active = false;
+    pthread_mutex_unlock(&session->lock);
+
+    for (int i = 1; i <= total; i++) {
+        frame_arena_release(frames[i]);
+    }
+    if (transport == A3_TRANSPORT_STREAM) {
+        session->transport_ops->stream_close(session, stream);
+    }
+
+    if (result) {
+        session->success_count += total;
+    } else {
+        session->fail_count++;
+    }
+    return result;
+}
+
+// 执行一个上传任务：先差分再压缩，每一步只在数据变短时采用
+// 设备拒绝带标志的A2时去掉对应标志重发：旧固件不支持压缩，或设备不再持有差分基准
+static bool session_send_upload(ble_session_t* session, ble_bulk_job_t* job) {
+    size_t segment_size = session->segment_size ? session->segment_size : A3_LEGACY_SEGMENT;
+    ble_cmd_a2_t a2;
+    bool result;
+
+    for (;;) {
+        const uint8_t* data = job->data;
+        size_t data_len = job->data_len;
+        uint8_t* delta = NULL;
+        uint8_t* packed = NULL;
+
+        a2 = job->a2;
+
+        // 差分：设备已持有的块只发块序号，结果不比原始数据短时返回0
+        if (session->delta && session->delta_cache.valid && data_len > 1) {
+            delta = malloc(data_len - 1);
+            size_t delta_len = delta ? ble_delta_encode(&session->delta_cache, data, data_len, delta, data_len - 1) : 0;
+            if (delta_len > 0) {
+                printf("差分上传: %zu -> %zu 字节\n", data_len, delta_len);
+                data = delta;
+                data_len = delta_len;
+                a2.char_len |= A2_FLAG_DELTA;
+            }
+        }
+
+        // 压缩：只在A3包数更少时采用
+        if (session->compress && data_len > 1) {
+            packed = malloc(data_len - 1);
+            size_t packed_len = packed ? ble_compress(data, data_len, packed, data_len - 1) : 0;
+            uint8_t raw_packets = a3_packet_count(data_len, segment_size);
+            uint8_t packed_packets = a3_packet_count(packed_len, segment_size);
+            if (packed_packets != 0 && (raw_packets == 0 || packed_packets < raw_packets)) {
+                printf("压缩上传: %zu -> %zu 字节，A3包 %d -> %d\n",
+                       data_len, packed_len, raw_packets, packed_packets);
+                data = packed;
+                data_len = packed_len;
+                a2.char_len |= A2_FLAG_COMPRESSED;
+            }
+        }
+
+        result = send_a2_a3_windowed(session, &a2, data, data_len, session->window_size,
+                                     session->segment_size, session->a3_transport);
+        free(delta);
+        free(packed);
+
+        if (result || !session->a2_rejected || !(a2.char_len & (A2_FLAG_COMPRESSED | A2_FLAG_DELTA))) {
+            break;
+        }
+        if (a2.char_len & A2_FLAG_COMPRESSED) {
+            printf("设备不接受压缩数据，关闭压缩\n");
+            session->compress = false;
         }
+        if (a2.char_len & A2_FLAG_DELTA) {
+            // 第一次被拒绝时完整重发一次；完整上传成功后仍被拒绝说明固件不支持
+            if (session->delta_rejected) {
+                printf("设备不接受差分数据，关闭差分\n");
+                session->delta = false;
+            }
+            session->delta_rejected = true;
+            ble_delta_cache_invalidate(&session->delta_cache);
+        }
+    }
+
+    // 记录设备持有的数据；上传失败时设备状态未知，下一次完整上传
+    if (result && session->delta) {
+        ble_delta_cache_update(&session->delta_cache, job->data, job->data_len);
+        if (a2.char_len & A2_FLAG_DELTA) {
+            session->delta_rejected = false;
+        }
+    } else {
+        ble_delta_cache_invalidate(&session->delta_cache);
     }
+    return result;
+}
+
+// 发送线程：先发控制帧，再逐个执行上传任务，上传过程中在窗口之间插入控制帧
+static void* session_dispatcher(void* arg) {
+    ble_session_t* session = arg;
+
+    pthread_mutex_lock(&session->lock);
+    for (;;) {
+        while (!control_pending(session) && session->bulk_count == 0 && !session->queue_closed) {
+            session->dispatch_busy = false;
+            pthread_cond_broadcast(&session->cond);
+            pthread_cond_wait(&session->cond, &session->lock);
+        }
+        if (!control_pending(session) && session->bulk_count == 0) {
+            break;  // 队列已关闭且已清空
+        }
+        session->dispatch_busy = true;
+
+        if (control_pending(session)) {
+            pthread_mutex_unlock(&session->lock);
+            service_control_queue(session);
+            pthread_mutex_lock(&session->lock);
+            continue;
+        }
+
+        ble_bulk_job_t job = session->bulk_queue[session->bulk_head];
+        session->bulk_head = (session->bulk_head + 1) % BULK_QUEUE_LEN;
+        session->bulk_count--;
+        pthread_mutex_unlock(&session->lock);
+
+        session_send_upload(session, &job);
+
+        pthread_mutex_lock(&session->lock);
+    }
+    session->dispatch_busy = false;
+    pthread_cond_broadcast(&session->cond);
+    pthread_mutex_unlock(&session->lock);
+    return NULL;
+}
+
+// 启动会话发送线程
+int ble_session_start_dispatcher(ble_session_t* session) {
+    session->queue_closed = false;
+    session->dispatch_busy = false;
+    return pthread_create(&session->dispatcher, NULL, session_dispatcher, session);
+}
+
+// 关闭发送队列并等待发送线程退出
+void ble_session_stop_dispatcher(ble_session_t* session) {
+    pthread_mutex_lock(&session->lock);
+    session->queue_closed = true;
+    pthread_cond_broadcast(&session->cond);
+    pthread_mutex_unlock(&session->lock);
+    pthread_join(session->dispatcher, NULL);
+}
 
+// 排队A0调速，未发出的调速被新档位覆盖
+bool ble_session_queue_gear(ble_session_t* session, uint8_t gear) {
+    pthread_mutex_lock(&session->lock);
+    if (session->queue_closed) {
+        pthread_mutex_unlock(&session->lock);
+        return false;
+    }
+    session->gear = gear;
+    session->gear_pending = true;
+    pthread_cond_broadcast(&session->cond);
+    pthread_mutex_unlock(&session->lock);
+    return true;
+}
+
+// 排队A1基础信息
+bool ble_session_queue_a1(ble_session_t* session, const ble_cmd_a1_t* a1_data) {
+    pthread_mutex_lock(&session->lock);
+    if (session->queue_closed || session->a1_count >= CONTROL_QUEUE_LEN) {
+        pthread_mutex_unlock(&session->lock);
+        return false;
+    }
+    session->a1_queue[(session->a1_head + session->a1_count) % CONTROL_QUEUE_LEN] = *a1_data;
+    session->a1_count++;
+    pthread_cond_broadcast(&session->cond);
+    pthread_mutex_unlock(&session->lock);
+    return true;
+}
+
+// 排队A2+A3上传
+bool ble_session_queue_upload(ble_session_t* session, const ble_cmd_a2_t* a2_data,
+                              const uint8_t* data, size_t data_len) {
+    // char_len的高两位是A2_FLAG_*，字符数超过A2_CHAR_LEN_MASK会被设备当成压缩或差分标志
+    if (a2_data->char_len > A2_CHAR_LEN_MASK) {
+        fprintf(stderr, "字符数过多: %u (最多%d)\n", a2_data->char_len, A2_CHAR_LEN_MASK);
+        return false;
+    }
+    pthread_mutex_lock(&session->lock);
+    if (session->queue_closed || session->bulk_count >= BULK_QUEUE_LEN) {
+        pthread_mutex_unlock(&session->lock);
+        return false;
+    }
+    ble_bulk_job_t* job = &session->bulk_queue[(session->bulk_head + session->bulk_count) % BULK_QUEUE_LEN];
+    job->a2 = *a2_data;
+    job->data = data;
+    job->data_len = data_len;
+    session->bulk_count++;
+    pthread_cond_broadcast(&session->cond);
+    pthread_mutex_unlock(&session->lock);
     return true;
 }
 
-// 连接回调函数
+// 排队一条渲染好的文字：字符数和类型列表来自渲染结果
+bool ble_session_queue_rendered(ble_session_t* session, const ble_render_msg_t* msg) {
+    ble_cmd_a2_t a2_data = {
+        .cmd = CMD_A2,
+        .char_len = msg->char_len,
+    };
+    memcpy(a2_data.type_list, msg->type_list, sizeof(a2_data.type_list));
+    return ble_session_queue_upload(session, &a2_data, msg->data, msg->data_len);
+}
+
+// 等待队列中所有帧发送完成
+void ble_session_flush(ble_session_t* session) {
+    pthread_mutex_lock(&session->lock);
+    while (control_pending(session) || session->bulk_count > 0 || session->dispatch_busy) {
+        pthread_cond_wait(&session->cond, &session->lock);
+    }
+    pthread_mutex_unlock(&session->lock);
+}
+
+#ifndef BLE_NO_MAIN
+// 调度器：一个进程、一个适配器同时驱动多个设备会话
+static struct {
+    ble_session_t sessions[BLE_MAX_SESSIONS];
+    size_t session_count;
+    pthread_mutex_t lock;       // 保护found_count、scan_closed和各会话的is_found
+    pthread_cond_t found_cond;  // 发现设备时唤醒主任务
+    size_t found_count;         // 已发现的设备数
+    bool scan_closed;           // 扫描等待已结束，之后发现的设备不再连接
+} m_scheduler;
+
+// 通知回调函数 (接收设备反馈)
+// 每个连接注册时以所属会话作为user_data，反馈直接路由到对应设备的会话
+// 通常只注册在反馈特征上由库按特征路由；旧版后端回退为连接级回调时会收到所有特征的通知，仍需比较UUID
+static void notification_callback(const uuid_t* uuid, const uint8_t* data, 
+                                 size_t data_length, void* user_data) {
+    ble_session_t* session = user_data;
+
+    // 反馈等待时间直接计入RTT，这里只写跟踪记录，不做格式化输出
+    if (gattlib_uuid_cmp(uuid, &session->notify_uuid) == 0) {
+        BLE_TRACE_DEBUG(BLE_TRACE_NOTIFY, session->mac_address, (uint32_t)data_length, 0, data, data_length);
+        ble_session_on_feedback(session, data, data_length);
+    } else {
+        BLE_TRACE_INFO(BLE_TRACE_NOTIFY_OTHER, session->mac_address, (uint32_t)data_length, 0, data, data_length);
+    }
+}
+
+// 标记会话连接失败，唤醒等待连接的工作线程
+static void session_connect_failed(ble_session_t* session) {
+    pthread_mutex_lock(&session->lock);
+    session->is_connected = false;
+    session->connect_failed = true;
+    pthread_cond_broadcast(&session->cond);
+    pthread_mutex_unlock(&session->lock);
+}
+
+// 连接回调函数 (user_data为设备会话)
 static void on_connect(gattlib_adapter_t* adapter, const char* dst, 
                       gattlib_connection_t* connection, int error, void* user_data) {
+    ble_session_t* session = user_data;
+
     if (error != 0) {
-        fprintf(stderr, "连接失败: %d\n", error);
-        pthread_mutex_lock(&m_state.lock);
-        m_state.is_connected = false;
-        pthread_cond_signal(&m_state.cond);
-        pthread_mutex_unlock(&m_state.lock);
+        fprintf(stderr, "[%s] 连接失败: %d\n", session->mac_address, error);
+        session_connect_failed(session);
         return;
     }
 
     printf("成功连接到设备: %s\n", dst);
-    // 步骤1：注册通知回调（关键修正）
-    int ret = gattlib_register_notification(connection, notification_callback, NULL);
-    if (ret != 0) {
-        fprintf(stderr, "注册通知回调失败: %d\n", ret);
-    } else {
-        printf("已注册通知回调\n");
+    // 启动通知监听，回调只绑定反馈特征，按会话路由
+    // 优先从AcquireNotify的socket读取，不支持时库内回退到D-Bus信号
+    int ret = gattlib_notification_start_acquired(connection, &session->notify_uuid, notification_callback, session);
+    if (ret == GATTLIB_NOT_SUPPORTED) {
+        // 旧版后端不支持按特征注册回调，回退为连接级回调
+        ret = gattlib_register_notification(connection, notification_callback, session);
+        if (ret == 0) {
+            ret = gattlib_notification_start(connection, &session->notify_uuid);
+        }
     }
-
-    // 步骤2：启动通知监听（仅传2个参数，修正编译错误）
-    ret = gattlib_notification_start(connection, &m_config.notify_uuid);
     if (ret != 0) {
-        fprintf(stderr, "启动通知监听失败: %d\n", ret);
+        fprintf(stderr, "[%s] 启动通知监听失败: %d\n", session->mac_address, ret);
+        gattlib_disconnect(connection, false);
+        session_connect_failed(session);
         return;
     } else {
         printf("已启动通知监听，等待设备反馈...\n");
-        // 关键：等待一小段时间确保通知完全启用
-        usleep(500000);  // 等待500ms，让设备准备就绪
     }
-    pthread_mutex_lock(&m_state.lock);
-    m_state.connection = connection;
-    m_state.is_connected = true;
-    pthread_cond_signal(&m_state.cond);
-    pthread_mutex_unlock(&m_state.lock);
+    // 通知是否真正启用由工作线程等待确认，回调运行在主循环线程，不能在这里阻塞
+    pthread_mutex_lock(&session->lock);
+    session->connection = connection;
+    session->is_connected = true;
+    pthread_cond_broadcast(&session->cond);
+    pthread_mutex_unlock(&session->lock);
 
 }
 // 生成72字节字符数据（示例：hello开头，后续填充x）
@@ -336,30 +1064,14 @@ static void generate_72bytes_char_data(uint8_t* buffer, size_t len) {
     buffer[len - 1] = '\n';
     buffer[len] = '\0';
 }
-// 连续发送函数
-static void send_continuous_data() {
-    pthread_mutex_lock(&m_state.lock);
-    while (!m_state.is_connected) {
-        pthread_cond_wait(&m_state.cond, &m_state.lock);
-    }
-    gattlib_connection_t* connection = m_state.connection;
-    pthread_mutex_unlock(&m_state.lock);
-
+// 连续发送函数：把示例数据排入会话发送队列
+static void send_continuous_data(ble_session_t* session) {
     // 示例1: 发送A0包 (调速，档位3)
     printf("\n===== 发送A0包 =====");
-    uint8_t a0_buffer[4];
-    ble_cmd_a0_t a0_data = {
-        .cmd = CMD_A0,
-        .gear = 3               // 档位3
-    };
-    size_t a0_len = build_a0_packet(&a0_data, a0_buffer, sizeof(a0_buffer));
-    if (a0_len > 0) {
-        send_packet_with_retry(connection, a0_buffer, a0_len);
-    }
+    ble_session_queue_gear(session, 3);
 
     // 示例2: 发送A1包 (基础信息)
     printf("\n===== 发送A1包 =====");
-    uint8_t a1_buffer[8];
     ble_cmd_a1_t a1_data = {
         .cmd = CMD_A1,
         .play_mode = 0x01,      // 播放模式
@@ -368,10 +1080,7 @@ static void send_continuous_data() {
         .effect_count = 10,     // 效果数目
         .current_effect = 3     // 当前效果序号
     };
-    size_t a1_len = build_a1_packet(&a1_data, a1_buffer, sizeof(a1_buffer));
-    if (a1_len > 0) {
-        send_packet_with_retry(connection, a1_buffer, a1_len);
-    }
+    ble_session_queue_a1(session, &a1_data);
 
     // 示例3: 发送A2+A3组合包
     printf("\n===== 发送A2+A3组合包 =====");
@@ -406,19 +1115,15 @@ static void send_continuous_data() {
     };
     ble_cmd_a2_t a2_data = {
         .cmd = CMD_A2,
-        .total_bytes = sizeof(big_data),
-        .total_packets = 3,
-        .char_len = 8,
+        .char_len = 8,          // total_bytes/total_packets由发送函数按分包长度计算
     };
     memcpy(a2_data.type_list, type_list, sizeof(type_list));
-    ble_cmd_a3_t* a3_data = malloc(sizeof(ble_cmd_a3_t) * a2_data.total_packets);
-    send_a2_a3_combination(
-        connection,
-        &a2_data,
-        a3_data,
-        big_data,           // 数据内容
-        sizeof(big_data)   // 数据长度
-    );
+    ble_session_queue_upload(session, &a2_data, big_data, sizeof(big_data));
+
+    // 上传过程中调速：插在A3窗口之间发送，连续调速只发最后一次
+    ble_session_queue_gear(session, 4);
+    ble_session_queue_gear(session, 5);
+    ble_session_flush(session);
     sleep(5);
     uint8_t big_data1[] = {
         0x4 , 0x4 , 0xc4, 0xfc, 0x14, 0x2f, 0xa4, 0xa4,
@@ -440,50 +1145,115 @@ static void send_continuous_data() {
         0x80, 0x80, 0x80, 0x0 , 0x80, 0x80, 0x80, 0x0 ,
         0x20, 0x20, 0x3f, 0x21, 0x20, 0x0 , 0x1 , 0x0  // 8
     };
-    a2_data.total_bytes = sizeof(big_data1);
-    a2_data.total_packets = 3;
     a2_data.char_len = 6;
     memcpy(a2_data.type_list, type_list, sizeof(type_list));
-    ble_cmd_a3_t* a3_data2 = malloc(sizeof(ble_cmd_a3_t) * a2_data.total_packets);
-    send_a2_a3_combination(
-        connection,
-        &a2_data,
-        a3_data2,
-        big_data1,           // 数据内容
-        sizeof(big_data1)   // 数据长度
-    );   
-    // 标记完成
-    pthread_mutex_lock(&m_state.lock);
-    m_state.is_finished = true;
-    pthread_cond_signal(&m_state.cond);
-    pthread_mutex_unlock(&m_state.lock);
+    ble_session_queue_upload(session, &a2_data, big_data1, sizeof(big_data1));
+
+    // 示例4: 文字渲染后上传 (有字库时)
+    ble_render_msg_t text_msg;
+    if (m_config.font && ble_render_text(m_config.font, "你好，BLE!", &text_msg) > 0) {
+        printf("\n===== 发送文字 (%d个字符) =====", text_msg.char_len);
+        ble_session_queue_rendered(session, &text_msg);
+    }
+
+    // 数据在栈上，返回前等待发送完成
+    ble_session_flush(session);
 }
 
 
 
-// 扫描回调函数：发现目标设备后停止扫描并连接
+// 标记会话已发现并发起连接；已发现过或扫描等待已结束时返回false
+static bool session_start_connect(gattlib_adapter_t* adapter, ble_session_t* session) {
+    pthread_mutex_lock(&m_scheduler.lock);
+    bool ignore = session->is_found || m_scheduler.scan_closed;
+    if (!ignore) {
+        session->is_found = true;
+        m_scheduler.found_count++;
+        pthread_cond_signal(&m_scheduler.found_cond);
+    }
+    pthread_mutex_unlock(&m_scheduler.lock);
+    if (ignore) {
+        return false;
+    }
+
+    printf("正在连接设备 %s...\n", session->mac_address);
+    int ret = gattlib_connect(adapter, session->mac_address,
+                        GATTLIB_CONNECTION_OPTIONS_NONE, on_connect, session);
+    if (ret != 0) {
+        fprintf(stderr, "[%s] 连接请求失败: %d\n", session->mac_address, ret);
+        session_connect_failed(session);
+    }
+    return true;
+}
+
+// 扫描回调函数：发现会话中的设备后立即发起连接
 static void ble_discovered_device(gattlib_adapter_t* adapter, const char* addr, const char* name, void* user_data) {
-    if (strcasecmp(addr, m_config.mac_address) == 0) {
-        printf("发现目标设备: %s\n", addr);
-        device_found = true;
-        gattlib_adapter_scan_disable(adapter); // 停止扫描
-
-        // 发起连接
-        printf("正在连接设备 %s...\n", m_config.mac_address);
-        int ret = gattlib_connect(adapter, m_config.mac_address, 
-                            GATTLIB_CONNECTION_OPTIONS_NONE, on_connect, NULL);
-        if (ret != 0) {
-            fprintf(stderr, "连接请求失败: %d\n", ret);
-            gattlib_adapter_close(adapter);
+    for (size_t i = 0; i < m_scheduler.session_count; i++) {
+        ble_session_t* session = &m_scheduler.sessions[i];
+        if (strcasecmp(addr, session->mac_address) == 0) {
+            if (session_start_connect(adapter, session)) {
+                printf("发现目标设备: %s\n", addr);
+            }
             return;
         }
     }
 }
 
+// 会话工作线程：等待连接完成后启动发送线程，并排入该设备的发送任务
+static void* session_worker(void* arg) {
+    ble_session_t* session = arg;
+
+    pthread_mutex_lock(&session->lock);
+    while (!session->is_connected && !session->connect_failed) {
+        pthread_cond_wait(&session->cond, &session->lock);
+    }
+    bool connected = session->is_connected;
+    pthread_mutex_unlock(&session->lock);
+
+    if (connected) {
+        // 等待CCCD写入完成(通知真正启用)后再发第一帧，否则设备的反馈会丢失
+        int ret = gattlib_notification_wait_ready(session->connection, &session->notify_uuid, NOTIFY_READY_TIMEOUT_MS);
+        if (ret != 0) {
+            fprintf(stderr, "[%s] 等待通知启用失败: %d，继续发送\n", session->mac_address, ret);
+        }
+
+        // 发送特征的句柄在服务发现后解析一次，之后的写入和重发都按句柄进行
+        if (gattlib_get_handle_from_uuid(session->connection, &session->char_uuid, &session->char_handle) == GATTLIB_SUCCESS) {
+            printf("[%s] 发送特征句柄: 0x%04X\n", session->mac_address, session->char_handle);
+        } else {
+            session->char_handle = 0;
+            printf("[%s] 未解析到发送特征句柄，按UUID写入\n", session->mac_address);
+        }
+
+        // A3分包长度跟随连接MTU，无响应写入时整包不能超过一个ATT PDU
+        session->mtu = query_connection_mtu(session);
+        session->segment_size = (session->a3_transport == A3_TRANSPORT_WRITE_REQ) ?
+                                a3_segment_size(session->mtu) : a3_pdu_segment_size(session->mtu);
+        printf("[%s] ATT MTU: %u, A3数据段长度: %zu\n",
+               session->mac_address, session->mtu, session->segment_size);
+
+        ret = ble_session_start_dispatcher(session);
+        if (ret != 0) {
+            fprintf(stderr, "[%s] 创建发送线程失败: %d\n", session->mac_address, ret);
+        } else {
+            send_continuous_data(session);
+            ble_session_stop_dispatcher(session);
+        }
+    }
+
+    // 标记完成
+    pthread_mutex_lock(&session->lock);
+    session->is_finished = true;
+    pthread_cond_broadcast(&session->cond);
+    pthread_mutex_unlock(&session->lock);
+    return NULL;
+}
 
 // 主任务函数
 void* ble_task(void* arg) {
     gattlib_adapter_t* adapter;
+    bool started[BLE_MAX_SESSIONS] = {false};
+    size_t found_count;
     int ret;
 
     // 打开适配器
@@ -493,72 +1263,115 @@ void* ble_task(void* arg) {
         return NULL;
     }
 
-    // 开始扫描设备（超时30秒）
-    printf("正在扫描设备 %s...\n", m_config.mac_address);
-    ret = gattlib_adapter_scan_enable(adapter, ble_discovered_device, 30, NULL);
-    if (ret != 0) {
-        fprintf(stderr, "扫描失败: %d\n", ret);
-        gattlib_adapter_close(adapter);
-        return NULL;
+    // BlueZ已记录的设备（之前扫描过或已配对）直接连接，不需要扫描
+    for (size_t i = 0; i < m_scheduler.session_count; i++) {
+        ble_session_t* session = &m_scheduler.sessions[i];
+        if (gattlib_adapter_register_known_device(adapter, session->mac_address) == GATTLIB_SUCCESS) {
+            printf("设备 %s 已知，直接连接\n", session->mac_address);
+            session_start_connect(adapter, session);
+        }
     }
 
-    // 等待扫描发现设备
-    int scan_wait = 0;
-    while (!device_found && scan_wait < 30) { // 最多等30秒
-        g_usleep(1000000); // 每秒检查一次
-        scan_wait++;
+    pthread_mutex_lock(&m_scheduler.lock);
+    found_count = m_scheduler.found_count;
+    pthread_mutex_unlock(&m_scheduler.lock);
+
+    if (found_count < m_scheduler.session_count) {
+        // 其余设备扫描发现，扫描不阻塞，发现设备时回调立即连接并唤醒这里
+        printf("正在扫描 %zu 个设备...\n", m_scheduler.session_count - found_count);
+        ret = gattlib_adapter_scan_enable_with_filter_non_blocking(adapter, NULL, 0,
+                GATTLIB_DISCOVER_FILTER_USE_NONE, ble_discovered_device, BLE_SCAN_TIMEOUT_SEC, NULL);
+        if (ret != 0) {
+            fprintf(stderr, "扫描失败: %d\n", ret);
+        } else {
+            struct timespec deadline;
+            deadline_after_ms(&deadline, BLE_SCAN_TIMEOUT_SEC * 1000L);
+
+            pthread_mutex_lock(&m_scheduler.lock);
+            int wait_ret = 0;
+            while (m_scheduler.found_count < m_scheduler.session_count && wait_ret != ETIMEDOUT) {
+                wait_ret = pthread_cond_timedwait(&m_scheduler.found_cond, &m_scheduler.lock, &deadline);
+            }
+            pthread_mutex_unlock(&m_scheduler.lock);
+            gattlib_adapter_scan_disable(adapter);
+        }
     }
-    if (!device_found) {
-        fprintf(stderr, "30秒内未发现目标设备\n");
+
+    // 之后发现的设备不再连接
+    pthread_mutex_lock(&m_scheduler.lock);
+    m_scheduler.scan_closed = true;
+    found_count = m_scheduler.found_count;
+    pthread_mutex_unlock(&m_scheduler.lock);
+
+    if (found_count == 0) {
+        fprintf(stderr, "%d秒内未发现目标设备\n", BLE_SCAN_TIMEOUT_SEC);
         gattlib_adapter_close(adapter);
         return NULL;
     }
+    if (found_count < m_scheduler.session_count) {
+        for (size_t i = 0; i < m_scheduler.session_count; i++) {
+            if (!m_scheduler.sessions[i].is_found) {
+                fprintf(stderr, "%d秒内未发现设备 %s\n", BLE_SCAN_TIMEOUT_SEC, m_scheduler.sessions[i].mac_address);
+            }
+        }
+    }
 
-    // 等待连接完成并执行发送任务
-    send_continuous_data();
-    
-    // 等待发送完成后断开连接
-    pthread_mutex_lock(&m_state.lock);
-    while (!m_state.is_finished) {
-        pthread_cond_wait(&m_state.cond, &m_state.lock);
+    // 每个已发现的设备一个工作线程，各设备并行发送
+    for (size_t i = 0; i < m_scheduler.session_count; i++) {
+        ble_session_t* session = &m_scheduler.sessions[i];
+        if (!session->is_found) {
+            continue;
+        }
+        ret = pthread_create(&session->thread, NULL, session_worker, session);
+        if (ret != 0) {
+            fprintf(stderr, "[%s] 创建发送线程失败: %d\n", session->mac_address, ret);
+            continue;
+        }
+        started[i] = true;
     }
-    pthread_mutex_unlock(&m_state.lock);
 
-    // 断开连接
-    gattlib_disconnect(m_state.connection, true);
+    // 等待所有设备发送完成后断开连接
+    for (size_t i = 0; i < m_scheduler.session_count; i++) {
+        if (started[i]) {
+            pthread_join(m_scheduler.sessions[i].thread, NULL);
+        }
+    }
+    for (size_t i = 0; i < m_scheduler.session_count; i++) {
+        ble_session_t* session = &m_scheduler.sessions[i];
+        if (session->connection) {
+            gattlib_disconnect(session->connection, true);
+            session->connection = NULL;
+        }
+    }
     gattlib_adapter_close(adapter);
     return NULL;
 }
 
 // 帮助信息
 void usage(const char* program) {
-    printf("用法: %s <设备MAC> <发送特征UUID> <通知特征UUID>\n", program);
-    printf("示例: %s 70:19:88:3D:30:68 0000ffe1-0000-1000-8000-00805f9b34fb 0000ffe4-0000-1000-8000-00805f9b34fb\n", program);
-    printf("说明: 发送四种协议数据包并处理反馈\n");
+    printf("用法: %s [设备MAC ...]\n", program);
+    printf("示例: %s 70:19:88:3D:30:68 70:19:88:3D:30:97\n", program);
+    printf("说明: 同时向最多%d个设备发送四种协议数据包并处理反馈，不指定MAC时使用默认设备\n", BLE_MAX_SESSIONS);
 }
 #define SEND_UUID "0000ffe1-0000-1000-8000-00805f9b34fb"
 #define RECV_UUID "0000ffe4-0000-1000-8000-00805f9b34fb"
 
 #define MAC_ADDRESS "70:19:88:3D:30:97"
-int main() {
+#define FONT_HZK16_PATH "HZK16"    // GB2312 16x16点阵字库
+#define FONT_ASC16_PATH "ASC16"    // 8x16 ASCII点阵字库
+int main(int argc, char* argv[]) {
     // 检查参数
-
-    // 初始化状态变量
-    pthread_mutex_init(&m_state.lock, NULL);
-    pthread_cond_init(&m_state.cond, NULL);
-    m_state.is_connected = false;
-    m_state.is_finished = false;
-    m_state.success_count = 0;
-    m_state.fail_count = 0;
-    m_state.last_send_success = false;
-    m_state.last_packet = NULL;
-    m_state.last_packet_len = 0;
-    m_state.waiting_feedback = false;
-    device_found = false;
+    if (argc - 1 > BLE_MAX_SESSIONS) {
+        usage(argv[0]);
+        return 1;
+    }
 
     // 解析参数
-    m_config.mac_address = MAC_ADDRESS;
     m_config.adapter_name = NULL;  // 使用默认适配器(hci0)
+    m_config.a3_transport = A3_TRANSPORT_WRITE_CMD; // A3包连续推送，失败时退回带响应写入
+    m_config.compress = false;     // 设备固件支持A2_FLAG_COMPRESSED时可打开，被拒绝时自动改发原始数据
+    m_config.delta = false;        // 设备固件支持A2_FLAG_DELTA时可打开，被拒绝时自动完整上传
+    m_config.font = ble_font_open(FONT_HZK16_PATH, FONT_ASC16_PATH, 0); // 没有字库时不发文字示例
     
     // 解析发送特征UUID
     if (gattlib_string_to_uuid(SEND_UUID, strlen(SEND_UUID) + 1, &m_config.char_uuid) != 0) {
@@ -572,19 +1385,51 @@ int main() {
         return 1;
     }
 
+    // 初始化设备会话
+    pthread_mutex_init(&m_scheduler.lock, NULL);
+    pthread_cond_init(&m_scheduler.found_cond, NULL);
+    m_scheduler.found_count = 0;
+    m_scheduler.scan_closed = false;
+    m_scheduler.session_count = 0;
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            ble_session_init(&m_scheduler.sessions[m_scheduler.session_count++], argv[i]);
+        }
+    } else {
+        ble_session_init(&m_scheduler.sessions[m_scheduler.session_count++], MAC_ADDRESS);
+    }
+
+    // 通知回调中的跟踪记录由后台线程输出
+    if (ble_trace_start(stdout) != 0) {
+        fprintf(stderr, "启动跟踪线程失败\n");
+    }
+
     // 启动主循环
     printf("开始BLE协议数据发送测试...\n");
     int ret = gattlib_mainloop(ble_task, NULL);
+    ble_trace_stop();
 
     // 输出统计结果
+    int success_count = 0;
+    int fail_count = 0;
+    for (size_t i = 0; i < m_scheduler.session_count; i++) {
+        ble_session_t* session = &m_scheduler.sessions[i];
+        printf("[%s] 成功: %d, 失败: %d\n",
+               session->mac_address, session->success_count, session->fail_count);
+        success_count += session->success_count;
+        fail_count += session->fail_count;
+    }
     printf("\n发送完成 - 成功: %d, 失败: %d, 总尝试: %d\n",
-           m_state.success_count, m_state.fail_count, 
-           m_state.success_count + m_state.fail_count);
+           success_count, fail_count, success_count + fail_count);
 
     // 清理资源
-    free(m_state.last_packet);
-    pthread_mutex_destroy(&m_state.lock);
-    pthread_cond_destroy(&m_state.cond);
+    for (size_t i = 0; i < m_scheduler.session_count; i++) {
+        ble_session_destroy(&m_scheduler.sessions[i]);
+    }
+    pthread_cond_destroy(&m_scheduler.found_cond);
+    pthread_mutex_destroy(&m_scheduler.lock);
+    ble_font_close(m_config.font);
 
     return ret;
-}
\ No newline at end of file
+}
+#endif  /* BLE_NO_MAIN */
@@ -7,6 +7,10 @@
 #include <gattlib.h>
 #include <stdint.h>
 #include <time.h>
+#include <pthread.h>
+#include "ble_delta.h"
+#include "ble_render.h"
+#include "ble_proto.h"
 
 // 协议常量定义
 #define CMD_A0 0xA0
@@ -15,70 +19,165 @@
 #define CMD_A3 0xA3
 #define NOTIFY_UUID "0xffe4"
 #define MAX_RETRIES 3           // 最大重发次数
-#define FEEDBACK_TIMEOUT_MS 1000 // 反馈超时时间(毫秒)
+#define FEEDBACK_TIMEOUT_MS 1000 // 初始反馈超时时间(毫秒)，有RTT样本后按测量值计算
+#define RTO_MIN_MS 100           // 反馈超时下限(毫秒)
+#define RTO_MAX_MS 8000          // 反馈超时上限(毫秒)，指数退避不超过此值
+#define A3_WINDOW_SIZE 4         // 滑动窗口大小(同时在途的A3包数)
+#define A3_WINDOW_MAX 16         // 滑动窗口上限
+#define ATT_DEFAULT_LE_MTU 23    // 未交换MTU时的默认值
+#define ATT_WRITE_HEADER_LEN 3   // ATT写请求头(opcode + handle)
+#define A3_HEADER_LEN 3          // A3包头(cmd + packet_num + data_len)，与ble_proto.h的字段表一致
+#define A3_CHECKSUM_LEN 2        // A3数据校验
+#define A3_LEGACY_SEGMENT 64     // 原固定长度数据段，MTU较小时仍按此长度分包
+#define A3_MAX_SEGMENT 255       // data_len只有一个字节
+#define FRAME_SLOT_SIZE (A3_HEADER_LEN + A3_MAX_SEGMENT + A3_CHECKSUM_LEN) // 帧槽大小(足够容纳最长的A3包)
+#define FRAME_ARENA_SLOTS 32     // 每个连接的帧槽数(需大于A3_WINDOW_MAX)
+#define A2_FLAG_COMPRESSED 0x80  // A2 char_len最高位：A3数据经ble_compress压缩，设备解压后按字符显示
+#define A2_FLAG_DELTA 0x40       // A2 char_len次高位：A3数据为ble_delta差分，两个标志同时出现时先解压再还原
+#define A2_CHAR_LEN_MASK 0x3F    // A2 char_len中的字符数
 
 
-// A0命令：调速
+// A0~A3命令结构体 (ble_cmd_a0_t ~ ble_cmd_a3_t) 和设备反馈由 ble_proto.h 的字段表生成
+
+// A3包在滑动窗口中的状态
+typedef enum {
+    A3_PKT_PENDING = 0,     // 未发送
+    A3_PKT_IN_FLIGHT,       // 已发送，等待反馈
+    A3_PKT_ACKED,           // 收到成功反馈
+    A3_PKT_NAKED            // 收到失败反馈或超时，等待选择性重发
+} a3_packet_state_t;
+
+// 反馈往返时间估计 (RFC 6298)
+typedef struct {
+    bool has_sample;            // 是否已有有效样本
+    long srtt_us;               // 平滑RTT(微秒)
+    long rttvar_us;             // RTT偏差(微秒)
+    long rto_ms;                // 当前反馈超时(毫秒)，含退避
+} ble_rtt_t;
+
+// A3数据包的发送方式，可靠性都由设备的通知反馈保证
+typedef enum {
+    A3_TRANSPORT_WRITE_REQ = 0,  // 带响应写入，每包一次ATT请求往返
+    A3_TRANSPORT_WRITE_CMD,      // 无响应写入(Write Command)，连续推送
+    A3_TRANSPORT_STREAM          // AcquireWrite文件描述符 (BlueZ 5.48+)
+} a3_transport_t;
+
+// 帧槽：构建函数直接把数据包编码进槽内，重发时原地引用
 typedef struct {
-    uint8_t cmd;            // 命令字 (0xA0)
-    uint8_t gear;           // 档位 (0x1C 等)
-    uint16_t checksum;       // 校验和
-} __attribute__((packed)) ble_cmd_a0_t;
+    uint8_t data[FRAME_SLOT_SIZE];
+    size_t len;
+    bool in_use;
+} ble_frame_t;
 
-// A1命令：基础信息
+// 帧环：每个连接一组固定大小的帧槽，按环形顺序分配，发送路径上不再malloc
+// 只在发送线程中使用，不需要加锁
 typedef struct {
-    uint8_t cmd;            // 命令字 (0xA1)
-    uint8_t play_mode;      // 播放模式
-    uint8_t total_lists;    // 总列表数
-    uint8_t current_list;   // 当前列表
-    uint8_t effect_count;   // 效果数目
-    uint8_t current_effect; // 当前列表效果序号
-    uint16_t checksum;       // 校验和
-} __attribute__((packed)) ble_cmd_a1_t;
-
-// A2命令：包头
+    ble_frame_t slots[FRAME_ARENA_SLOTS];
+    unsigned int next;
+} ble_frame_arena_t;
+
+
+#define BLE_MAX_SESSIONS 8       // 一个进程同时驱动的最大设备数
+#define BLE_SCAN_TIMEOUT_SEC 30  // 扫描等待设备的最长时间(秒)
+#define NOTIFY_READY_TIMEOUT_MS 3000 // 等待通知启用(CCCD写入完成)的最长时间(毫秒)
+#define CONTROL_QUEUE_LEN 8      // 每个会话排队的A1控制帧数
+#define BULK_QUEUE_LEN 4         // 每个会话排队的A2+A3上传任务数
+
+
+// 排队的A2+A3上传任务，data由调用者持有，任务完成前须保持有效
 typedef struct {
-    uint8_t cmd;            // 命令字 (0xA2)
-    uint16_t total_bytes;   // 总字节数 (小端序)
-    uint8_t total_packets;  // 总包数
-    uint8_t char_len;      // 总字符数
-    uint8_t type_list[16];
-    uint16_t checksum;       // 校验和
-} __attribute__((packed)) ble_cmd_a2_t;
-
-// A3命令：数据包 (可变长度)
+    ble_cmd_a2_t a2;
+    const uint8_t* data;
+    size_t data_len;
+} ble_bulk_job_t;
+
+typedef struct ble_session ble_session_t;
+
+// 发送传输接口：默认走gattlib，基准测试时可替换为本地模拟设备 (ble_sim.c)
+// 模拟设备通过ble_session_on_feedback()送回反馈
 typedef struct {
-    uint8_t cmd;            // 命令字 (0xA3)
-    uint8_t packet_num;     // 当前包序号 (从1开始)
-    uint8_t data_len;        // 保留字节
-      // 本包数据校验
-    uint8_t data[64];         // 可变长度数据
-    uint16_t data_checksum;
-} __attribute__((packed)) ble_cmd_a3_t;
+    // 带响应写入
+    int (*write_req)(ble_session_t* session, const uint8_t* data, size_t len);
+    // 无响应写入
+    int (*write_cmd)(ble_session_t* session, const uint8_t* data, size_t len);
+    // 打开AcquireWrite流，mtu返回连接的ATT MTU
+    int (*stream_open)(ble_session_t* session, gattlib_stream_t** stream, uint16_t* mtu);
+    int (*stream_write)(ble_session_t* session, gattlib_stream_t* stream, const uint8_t* data, size_t len);
+    int (*stream_close)(ble_session_t* session, gattlib_stream_t* stream);
+} ble_transport_ops_t;
 
+// gattlib传输 (写入按UUID，失败时按句柄0x0023)
+extern const ble_transport_ops_t ble_gattlib_transport;
 
-// 配置参数
+// 进程级配置参数，新建会话时复制到会话中
 static struct {
     const char* adapter_name;
+    uuid_t char_uuid;           // 发送特征UUID
+    uuid_t notify_uuid;         // 通知特征UUID
+    a3_transport_t a3_transport; // A3数据包发送方式
+    bool compress;              // 上传时尝试压缩 (设备固件需支持A2_FLAG_COMPRESSED)
+    bool delta;                 // 上传时只发设备没有的块 (设备固件需支持A2_FLAG_DELTA)
+    ble_font_t* font;           // 文字渲染字库，字库文件不存在时为NULL
+} m_config __attribute__((unused));
+
+// 设备会话：一个设备的配置、连接和反馈状态
+// 所有发送函数都只操作传入的会话，多个设备可以在各自的线程中并行发送
+struct ble_session {
+    // 配置
     const char* mac_address;
     uuid_t char_uuid;           // 发送特征UUID
+    uint16_t char_handle;       // 发送特征句柄，连接后解析一次 (0表示未解析，按UUID写入)
     uuid_t notify_uuid;         // 通知特征UUID
-} m_config;
+    a3_transport_t a3_transport; // A3数据包发送方式
+    bool compress;              // 上传时尝试压缩，设备拒绝带压缩标志的A2后关闭
+    bool delta;                 // 上传时尝试差分，完整上传后设备仍拒绝差分A2时关闭
+    const ble_transport_ops_t* transport_ops; // 写入接口，默认ble_gattlib_transport
+    void* transport_ctx;        // 传输接口私有数据
 
-// 连接状态控制
-static struct {
+    // 连接状态控制
+    pthread_t thread;           // 会话工作线程
     pthread_cond_t cond;
     pthread_mutex_t lock;
     gattlib_connection_t* connection;
+    bool is_found;              // 扫描时已发现设备
     bool is_connected;
+    bool connect_failed;        // 连接失败，工作线程不再等待
     bool is_finished;
     int success_count;
     int fail_count;
     bool last_send_success;     // 上一次发送结果
-    uint8_t* last_packet;       // 上一次发送的数据包
-    size_t last_packet_len;     // 上一次发送的数据包长度
+    bool last_send_rejected;    // 上一次发送收到设备明确的失败反馈 (超时、写入失败和无效反馈不算)
     bool waiting_feedback;      // 是否等待反馈
-} m_state;
+    bool feedback_received;     // 等待期间已收到反馈
+    ble_rtt_t rtt;              // 反馈往返时间估计 (受lock保护)
+    ble_frame_arena_t arena;    // 发送帧环
+    uint16_t mtu;               // 连接的ATT MTU (0表示未知)
+    size_t segment_size;        // 按MTU和发送方式得出的A3数据段长度
+    uint8_t window_size;        // A3滑动窗口大小，默认A3_WINDOW_SIZE
+    // 发送队列 (受lock保护)，控制帧优先于上传任务，上传中在窗口之间插入控制帧
+    pthread_t dispatcher;           // 发送线程，所有帧都由它写出
+    bool dispatch_busy;             // 发送线程正在处理队列
+    bool queue_closed;              // 不再接受新任务，队列清空后发送线程退出
+    bool gear_pending;              // 有待发送的A0调速
+    uint8_t gear;                   // 最新档位，重复调速只保留最后一次
+    ble_cmd_a1_t a1_queue[CONTROL_QUEUE_LEN];
+    unsigned int a1_head;
+    unsigned int a1_count;
+    ble_bulk_job_t bulk_queue[BULK_QUEUE_LEN];
+    unsigned int bulk_head;
+    unsigned int bulk_count;
+    // 滑动窗口传输状态 (下标即A3包序号packet_num)
+    bool window_active;             // 是否处于窗口传输模式
+    uint8_t window_state[256];      // 每个A3包的状态 (a3_packet_state_t)
+    uint32_t window_send_seq[256];  // 发送顺序，用于匹配不带包序号的反馈
+    uint8_t window_send_count[256]; // 每个包已发送次数，重发过的包不采样RTT
+    struct timespec window_sent_at[256]; // 最近一次发送时间 (CLOCK_MONOTONIC)
+    uint32_t window_seq;            // 发送顺序计数
+    // 上传编码状态 (只由发送线程使用)
+    bool a2_rejected;               // 最近一次上传的A2被设备明确回复失败
+    bool delta_rejected;            // 上一次差分A2被拒绝，之后还没有差分上传成功
+    ble_delta_cache_t delta_cache;  // 设备已持有的数据
+};
 
 
 // 数据包打印函数
@@ -92,23 +191,72 @@ size_t build_a1_packet(ble_cmd_a1_t* a1_data, uint8_t* buffer, size_t buffer_len
 // 构建A2包 (名称基本)
 
 size_t build_a2_packet(ble_cmd_a2_t *a2_data, uint8_t* buffer, size_t buffer_len) ;
-// 构建A3包 (字节数据)
+// 构建A3包 (字节数据，固定64字节数据段)
 size_t build_a3_packet(ble_cmd_a3_t* a3_data, uint8_t* buffer, size_t buffer_len) ;
-// 带重发机制的数据包发送函数
-bool send_packet_with_retry(gattlib_connection_t* connection, 
-                                  const uint8_t* data, size_t len);
+// 构建变长A3包：数据段按segment_len编码，不补0
+// 返回值：构建的数据包长度 (A3_HEADER_LEN + segment_len + A3_CHECKSUM_LEN)，0表示失败
+size_t encode_a3_packet(uint8_t packet_num, const uint8_t* segment, size_t segment_len,
+                        uint8_t* buffer, size_t buffer_len);
+// 根据ATT MTU计算A3数据段长度 (mtu为0时使用A3_LEGACY_SEGMENT)
+size_t a3_segment_size(uint16_t mtu);
+// 无响应写入时的A3数据段长度：整包必须放进一个ATT PDU (mtu未知时按默认MTU 23计算)
+size_t a3_pdu_segment_size(uint16_t mtu);
+// 计算数据按segment_size分包后的A3包数，超过255包时返回0
+uint8_t a3_packet_count(size_t data_len, size_t segment_size);
+// 初始化会话，配置从m_config复制
+void ble_session_init(ble_session_t* session, const char* mac_address);
+// 释放会话资源
+void ble_session_destroy(ble_session_t* session);
+// 获取会话连接的ATT MTU，不支持时返回0
+uint16_t query_connection_mtu(ble_session_t* session);
+// 从帧环中取一个空闲帧槽，没有空闲槽时返回NULL
+ble_frame_t* frame_arena_acquire(ble_frame_arena_t* arena);
+// 归还帧槽
+void frame_arena_release(ble_frame_t* frame);
+// 处理设备反馈 (0xffe4通知内容)，唤醒等待反馈的发送线程
+void ble_session_on_feedback(ble_session_t* session, const uint8_t* data, size_t data_length);
+// 启动会话发送线程 (连接建立后调用)
+int ble_session_start_dispatcher(ble_session_t* session);
+// 关闭发送队列并等待发送线程处理完剩余任务后退出
+void ble_session_stop_dispatcher(ble_session_t* session);
+// 排队A0调速，未发出的调速被新档位覆盖
+bool ble_session_queue_gear(ble_session_t* session, uint8_t gear);
+// 排队A1基础信息，队列满时返回false
+bool ble_session_queue_a1(ble_session_t* session, const ble_cmd_a1_t* a1_data);
+// 排队A2+A3上传，data在任务完成前须保持有效，队列满或字符数超过A2_CHAR_LEN_MASK时返回false
+bool ble_session_queue_upload(ble_session_t* session, const ble_cmd_a2_t* a2_data,
+                              const uint8_t* data, size_t data_len);
+// 排队一条渲染好的文字 (ble_render_text)，msg在任务完成前须保持有效，队列满时返回false
+bool ble_session_queue_rendered(ble_session_t* session, const ble_render_msg_t* msg);
+// 等待队列中所有帧发送完成
+void ble_session_flush(ble_session_t* session);
+// 带重发机制的数据包发送函数 (重发时直接使用data，不再另外缓存)
+bool send_packet_with_retry(ble_session_t* session, const uint8_t* data, size_t len);
+// 带重发机制的帧槽发送函数
+bool send_frame_with_retry(ble_session_t* session, const ble_frame_t* frame);
 
-// 发送A2+A3组合数据包
-bool send_a2_a3_combination(gattlib_connection_t* connection, 
+// 发送A2+A3组合数据包 (固定64字节分包)，a2_data->total_packets与data_len不一致时返回false
+bool send_a2_a3_combination(ble_session_t* session,
                                   ble_cmd_a2_t *a2_data, ble_cmd_a3_t* a3_data,
                                   const uint8_t* data, size_t data_len) ;
 
+// 滑动窗口方式发送A2+A3组合数据包
+// window_size个A3包同时在途，反馈按packet_num匹配，只重发失败的包
+// A3数据段长度由segment_size决定，a2_data的total_bytes/total_packets按此重新计算
+// transport为无响应写入方式时segment_size应取a3_pdu_segment_size()，
+// 无响应写入失败时自动退回带响应写入
+bool send_a2_a3_windowed(ble_session_t* session, ble_cmd_a2_t *a2_data,
+                         const uint8_t* data, size_t data_len, uint8_t window_size,
+                         size_t segment_size, a3_transport_t transport);
+
 
 
+#ifndef BLE_NO_MAIN
 // 主任务函数
 static void* ble_task(void* arg) ;
 
 // 帮助信息
 static void usage(const char* program);
+#endif
 
 #endif  /* BLE_BLUETOOTH_H */
\ No newline at end of file
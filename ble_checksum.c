@@ -0,0 +1,175 @@
+#include <pthread.h>
+#include "ble_checksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BLE_CHECKSUM_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || (defined(__arm__) && defined(__ARM_NEON))
+#define BLE_CHECKSUM_NEON 1
+#include <arm_neon.h>
+#if defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+// 各实现返回所有字节的和 (按2^32取模)，最终结果再取低16位
+typedef uint32_t (*sum_bytes_fn)(const uint8_t* data, size_t len);
+
+static uint32_t sum_bytes_scalar(const uint8_t* data, size_t len) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+#ifdef BLE_CHECKSUM_X86
+// SSE2：_mm_sad_epu8与0做差的绝对值和，即每8字节求和到一个64位通道
+__attribute__((target("sse2")))
+static uint32_t sum_bytes_sse2(const uint8_t* data, size_t len) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(data + i + 16));
+        acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(v0, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_sad_epu8(v1, zero));
+    }
+    if (i + 16 <= len) {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)(data + i));
+        acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(v0, zero));
+        i += 16;
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, _mm_add_epi64(acc0, acc1));
+    return (uint32_t)(lanes[0] + lanes[1]) + sum_bytes_scalar(data + i, len - i);
+}
+
+// AVX2：同样的做法，每次处理32字节
+// 尾部不调用SSE2实现：混用VEX与非VEX指令会带来状态切换开销
+__attribute__((target("avx2")))
+static uint32_t sum_bytes_avx2(const uint8_t* data, size_t len) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(data + i + 32));
+        acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(v0, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(v1, zero));
+    }
+    if (i + 32 <= len) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)(data + i));
+        acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(v0, zero));
+        i += 32;
+    }
+
+    acc0 = _mm256_add_epi64(acc0, acc1);
+    __m128i acc = _mm_add_epi64(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1));
+    if (i + 16 <= len) {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)(data + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(v0, _mm_setzero_si128()));
+        i += 16;
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    uint32_t sum = (uint32_t)(lanes[0] + lanes[1]);
+    for (; i < len; i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+#endif
+
+#ifdef BLE_CHECKSUM_NEON
+// NEON：字节两两相加到16位，再累加到32位通道
+static uint32_t sum_bytes_neon(const uint8_t* data, size_t len) {
+    uint32x4_t acc0 = vdupq_n_u32(0);
+    uint32x4_t acc1 = vdupq_n_u32(0);
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        acc0 = vpadalq_u16(acc0, vpaddlq_u8(vld1q_u8(data + i)));
+        acc1 = vpadalq_u16(acc1, vpaddlq_u8(vld1q_u8(data + i + 16)));
+    }
+    if (i + 16 <= len) {
+        acc0 = vpadalq_u16(acc0, vpaddlq_u8(vld1q_u8(data + i)));
+        i += 16;
+    }
+
+    uint32_t lanes[4];
+    vst1q_u32(lanes, vaddq_u32(acc0, acc1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_bytes_scalar(data + i, len - i);
+}
+#endif
+
+static sum_bytes_fn m_sum_bytes = sum_bytes_scalar;
+static const char* m_impl_name = "scalar";
+static pthread_once_t m_select_once = PTHREAD_ONCE_INIT;
+
+// 按CPU特性选择实现，只执行一次
+static void select_impl(void) {
+#ifdef BLE_CHECKSUM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        m_sum_bytes = sum_bytes_avx2;
+        m_impl_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        m_sum_bytes = sum_bytes_sse2;
+        m_impl_name = "sse2";
+    }
+#elif defined(BLE_CHECKSUM_NEON)
+#if defined(__arm__)
+    // 32位树莓派系统：确认内核报告了NEON
+    if (!(getauxval(AT_HWCAP) & HWCAP_NEON)) {
+        return;
+    }
+#endif
+    m_sum_bytes = sum_bytes_neon;
+    m_impl_name = "neon";
+#endif
+}
+
+// 短帧(A0/A1等)直接用标量累加，向量实现只在长数据上有收益
+#define SIMD_MIN_LEN 32
+
+static inline uint32_t sum_bytes(const uint8_t* data, size_t len) {
+    if (len < SIMD_MIN_LEN) {
+        return sum_bytes_scalar(data, len);
+    }
+    pthread_once(&m_select_once, select_impl);
+    return m_sum_bytes(data, len);
+}
+
+uint16_t ble_checksum(const uint8_t* data, size_t len) {
+    return (uint16_t)sum_bytes(data, len);
+}
+
+void ble_checksum_init(ble_checksum_ctx_t* ctx) {
+    ctx->sum = 0;
+}
+
+void ble_checksum_update(ble_checksum_ctx_t* ctx, const uint8_t* data, size_t len) {
+    ctx->sum += sum_bytes(data, len);
+}
+
+uint16_t ble_checksum_final(const ble_checksum_ctx_t* ctx) {
+    return (uint16_t)ctx->sum;
+}
+
+uint16_t ble_checksum_scalar(const uint8_t* data, size_t len) {
+    return (uint16_t)sum_bytes_scalar(data, len);
+}
+
+const char* ble_checksum_impl_name(void) {
+    pthread_once(&m_select_once, select_impl);
+    return m_impl_name;
+}
@@ -0,0 +1,32 @@
+#ifndef BLE_CHECKSUM_H
+
+#define BLE_CHECKSUM_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 协议帧校验和：所有字节累加，取低16位
+// 实现按CPU在运行时选择 (AVX2 / SSE2 / NEON / 标量)
+
+// 增量校验上下文：大数据可以边分包边累加
+typedef struct {
+    uint32_t sum;
+} ble_checksum_ctx_t;
+
+// 一次性计算校验和
+uint16_t ble_checksum(const uint8_t* data, size_t len);
+
+// 增量计算：init -> update(可多次) -> final
+// 对同一段数据，结果与ble_checksum()相同，与update的切分方式无关
+void ble_checksum_init(ble_checksum_ctx_t* ctx);
+void ble_checksum_update(ble_checksum_ctx_t* ctx, const uint8_t* data, size_t len);
+uint16_t ble_checksum_final(const ble_checksum_ctx_t* ctx);
+
+// 标量实现 (用于对比测试)
+uint16_t ble_checksum_scalar(const uint8_t* data, size_t len);
+
+// 当前使用的实现名称 ("avx2" / "sse2" / "neon" / "scalar")
+const char* ble_checksum_impl_name(void);
+
+#endif  /* BLE_CHECKSUM_H */
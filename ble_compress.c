@@ -0,0 +1,135 @@
+#include <stdbool.h>
+#include <string.h>
+#include "ble_compress.h"
+
+#define TOKEN_RUN   0x80
+#define TOKEN_MATCH 0xC0
+#define TOKEN_LEN_MASK 0x3F
+
+// 把src[start, end)作为原样段输出到dst[*out]，放不下时返回false
+static bool emit_literals(const uint8_t* src, size_t start, size_t end,
+                          uint8_t* dst, size_t* out, size_t dst_cap) {
+    while (start < end) {
+        size_t len = end - start;
+        if (len > BLE_COMPRESS_LITERAL_MAX) {
+            len = BLE_COMPRESS_LITERAL_MAX;
+        }
+        if (*out + 1 + len > dst_cap) {
+            return false;
+        }
+        dst[(*out)++] = (uint8_t)(len - 1);
+        memcpy(dst + *out, src + start, len);
+        *out += len;
+        start += len;
+    }
+    return true;
+}
+
+size_t ble_compress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap) {
+    size_t in = 0;
+    size_t out = 0;
+    size_t literal_start = 0;   // 尚未输出的原样数据起点
+
+    while (in < src_len) {
+        size_t max = src_len - in;
+        if (max > BLE_COMPRESS_MATCH_MAX) {
+            max = BLE_COMPRESS_MATCH_MAX;
+        }
+
+        // 重复段：当前字节连续出现的次数
+        size_t run = 1;
+        while (run < max && src[in + run] == src[in]) {
+            run++;
+        }
+
+        // 回溯段：在前BLE_COMPRESS_WINDOW字节中找最长匹配，距离相同长度时取最近的
+        size_t best_len = 0;
+        size_t best_dist = 0;
+        size_t window = (in < BLE_COMPRESS_WINDOW) ? in : BLE_COMPRESS_WINDOW;
+        if (run < max) {
+            for (size_t dist = 1; dist <= window; dist++) {
+                const uint8_t* ref = src + in - dist;
+                size_t len = 0;
+                while (len < max && ref[len] == src[in + len]) {
+                    len++;
+                }
+                if (len > best_len) {
+                    best_len = len;
+                    best_dist = dist;
+                    if (len == max) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        size_t len;
+        uint8_t token;
+        if (run >= BLE_COMPRESS_MATCH_MIN && run >= best_len) {
+            len = run;
+            token = TOKEN_RUN;
+        } else if (best_len >= BLE_COMPRESS_MATCH_MIN) {
+            len = best_len;
+            token = TOKEN_MATCH;
+        } else {
+            in++;
+            continue;
+        }
+
+        if (!emit_literals(src, literal_start, in, dst, &out, dst_cap) || out + 2 > dst_cap) {
+            return 0;
+        }
+        dst[out++] = token | (uint8_t)(len - BLE_COMPRESS_MATCH_MIN);
+        dst[out++] = (token == TOKEN_RUN) ? src[in] : (uint8_t)(best_dist - 1);
+        in += len;
+        literal_start = in;
+    }
+
+    if (!emit_literals(src, literal_start, src_len, dst, &out, dst_cap)) {
+        return 0;
+    }
+    return out;
+}
+
+size_t ble_decompress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap) {
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < src_len) {
+        uint8_t c = src[in++];
+
+        if (c < TOKEN_RUN) {
+            size_t len = (size_t)c + 1;
+            if (in + len > src_len || out + len > dst_cap) {
+                return 0;
+            }
+            memcpy(dst + out, src + in, len);
+            in += len;
+            out += len;
+            continue;
+        }
+
+        if (in >= src_len) {
+            return 0;
+        }
+        size_t len = (size_t)(c & TOKEN_LEN_MASK) + BLE_COMPRESS_MATCH_MIN;
+        uint8_t arg = src[in++];
+        if (out + len > dst_cap) {
+            return 0;
+        }
+        if ((c & TOKEN_MATCH) == TOKEN_MATCH) {
+            size_t dist = (size_t)arg + 1;
+            if (dist > out) {
+                return 0;
+            }
+            // 逐字节复制，距离小于长度时重复最近的数据
+            for (size_t i = 0; i < len; i++, out++) {
+                dst[out] = dst[out - dist];
+            }
+        } else {
+            memset(dst + out, arg, len);
+            out += len;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,34 @@
+#ifndef BLE_COMPRESS_H
+
+#define BLE_COMPRESS_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A3上传数据压缩：字节级RLE+短距离回溯，设备端只需已解码的数据本身作为窗口，不需要额外内存
+// 点阵字模大多是0x00和重复的列，压缩后A3包数明显减少
+//
+// 压缩数据由若干段组成，每段以一个控制字节c开头：
+//   0x00~0x7F  原样：后跟 c+1 个字节 (1~128)
+//   0x80~0xBF  重复：后跟1个字节b，输出 (c&0x3F)+3 个b (3~66)
+//   0xC0~0xFF  回溯：后跟1个字节d，从已输出数据的倒数第d+1个字节起逐字节复制 (c&0x3F)+3 个字节
+//              (距离1~256，复制区域可以与输出重叠)
+// 设备端解码参考ble_decompress()
+
+#define BLE_COMPRESS_LITERAL_MAX 128 // 原样段最大长度
+#define BLE_COMPRESS_MATCH_MIN 3     // 重复/回溯段最小长度，更短的不如原样输出
+#define BLE_COMPRESS_MATCH_MAX 66    // 重复/回溯段最大长度
+#define BLE_COMPRESS_WINDOW 256      // 回溯最大距离
+
+// 最坏情况(全部原样输出)的压缩长度
+#define BLE_COMPRESS_BOUND(len) ((len) + ((len) + BLE_COMPRESS_LITERAL_MAX - 1) / BLE_COMPRESS_LITERAL_MAX)
+
+// 压缩src，返回压缩后长度；dst放不下时返回0
+// dst_cap小于src_len时，返回0即表示压缩不划算
+size_t ble_compress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap);
+
+// 解压src，返回解压后长度；数据格式错误或dst放不下时返回0
+size_t ble_decompress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap);
+
+#endif  /* BLE_COMPRESS_H */
@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ble_delta.h"
+
+#define INDEX_MASK (BLE_DELTA_INDEX_SIZE - 1)
+
+_Static_assert((BLE_DELTA_INDEX_SIZE & INDEX_MASK) == 0, "BLE_DELTA_INDEX_SIZE必须是2的幂");
+_Static_assert(BLE_DELTA_INDEX_SIZE > BLE_DELTA_MAX_BLOCKS, "块哈希表必须能放下所有块");
+
+// FNV-1a，只用于查找，命中后再逐字节比较
+static uint64_t block_hash(const uint8_t* block) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < BLE_DELTA_BLOCK; i++) {
+        hash ^= block[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// 查找内容相同的块，返回块序号，没有时返回-1
+static int cache_lookup(const ble_delta_cache_t* cache, const uint8_t* block) {
+    uint64_t hash = block_hash(block);
+
+    for (size_t i = hash & INDEX_MASK; cache->index[i].used; i = (i + 1) & INDEX_MASK) {
+        if (cache->index[i].hash == hash &&
+            memcmp(cache->data + (size_t)cache->index[i].block * BLE_DELTA_BLOCK, block, BLE_DELTA_BLOCK) == 0) {
+            return cache->index[i].block;
+        }
+    }
+    return -1;
+}
+
+void ble_delta_cache_init(ble_delta_cache_t* cache) {
+    memset(cache, 0, sizeof(*cache));
+}
+
+void ble_delta_cache_free(ble_delta_cache_t* cache) {
+    free(cache->data);
+    ble_delta_cache_init(cache);
+}
+
+void ble_delta_cache_invalidate(ble_delta_cache_t* cache) {
+    cache->valid = false;
+}
+
+bool ble_delta_cache_update(ble_delta_cache_t* cache, const uint8_t* data, size_t len) {
+    if (len > cache->capacity) {
+        uint8_t* buffer = realloc(cache->data, len);
+        if (buffer == NULL) {
+            cache->valid = false;
+            return false;
+        }
+        cache->data = buffer;
+        cache->capacity = len;
+    }
+    memcpy(cache->data, data, len);
+    cache->len = len;
+
+    // 只索引完整块，内容重复的块保留第一个
+    memset(cache->index, 0, sizeof(cache->index));
+    size_t blocks = len / BLE_DELTA_BLOCK;
+    if (blocks > BLE_DELTA_MAX_BLOCKS) {
+        blocks = BLE_DELTA_MAX_BLOCKS;
+    }
+    for (size_t n = 0; n < blocks; n++) {
+        const uint8_t* block = cache->data + n * BLE_DELTA_BLOCK;
+        if (cache_lookup(cache, block) >= 0) {
+            continue;
+        }
+        uint64_t hash = block_hash(block);
+        size_t i = hash & INDEX_MASK;
+        while (cache->index[i].used) {
+            i = (i + 1) & INDEX_MASK;
+        }
+        cache->index[i].hash = hash;
+        cache->index[i].block = (uint8_t)n;
+        cache->index[i].used = true;
+    }
+    cache->valid = true;
+    return true;
+}
+
+size_t ble_delta_encode(const ble_delta_cache_t* cache, const uint8_t* src, size_t len,
+                        uint8_t* dst, size_t dst_cap) {
+    size_t out = 0;
+
+    if (!cache->valid || len == 0 || len > UINT16_MAX || dst_cap < 2) {
+        return 0;
+    }
+    dst[out++] = (len >> 8) & 0xFF;
+    dst[out++] = len & 0xFF;
+
+    for (size_t offset = 0; offset < len; offset += BLE_DELTA_BLOCK) {
+        size_t block_len = (len - offset < BLE_DELTA_BLOCK) ? len - offset : BLE_DELTA_BLOCK;
+        int ref = (block_len == BLE_DELTA_BLOCK) ? cache_lookup(cache, src + offset) : -1;
+
+        if (ref >= 0) {
+            if (out + 1 > dst_cap) {
+                return 0;
+            }
+            dst[out++] = (uint8_t)ref;
+        } else {
+            if (out + 1 + block_len > dst_cap) {
+                return 0;
+            }
+            dst[out++] = BLE_DELTA_LITERAL;
+            memcpy(dst + out, src + offset, block_len);
+            out += block_len;
+        }
+    }
+    return out;
+}
+
+size_t ble_delta_decode(const uint8_t* base, size_t base_len, const uint8_t* src, size_t src_len,
+                        uint8_t* dst, size_t dst_cap) {
+    if (src_len < 2) {
+        return 0;
+    }
+    size_t len = ((size_t)src[0] << 8) | src[1];
+    size_t in = 2;
+    if (len > dst_cap) {
+        return 0;
+    }
+
+    for (size_t offset = 0; offset < len; offset += BLE_DELTA_BLOCK) {
+        size_t block_len = (len - offset < BLE_DELTA_BLOCK) ? len - offset : BLE_DELTA_BLOCK;
+        if (in >= src_len) {
+            return 0;
+        }
+        uint8_t ref = src[in++];
+        if (ref == BLE_DELTA_LITERAL) {
+            if (in + block_len > src_len) {
+                return 0;
+            }
+            memcpy(dst + offset, src + in, block_len);
+            in += block_len;
+        } else {
+            if (block_len != BLE_DELTA_BLOCK || ((size_t)ref + 1) * BLE_DELTA_BLOCK > base_len) {
+                return 0;
+            }
+            memcpy(dst + offset, base + (size_t)ref * BLE_DELTA_BLOCK, BLE_DELTA_BLOCK);
+        }
+    }
+    return (in == src_len) ? len : 0;
+}
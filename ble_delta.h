@@ -0,0 +1,54 @@
+#ifndef BLE_DELTA_H
+
+#define BLE_DELTA_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A3上传差分：设备保留上一次完整收到的数据，再次上传时内容相同的64字节块只发块序号
+// 发送端按块内容哈希查找设备已持有的块，块位置变化(如文字前移)也能复用
+//
+// 差分数据格式：
+//   [0..1]  完整数据长度 (大端)
+//   之后每个块依次为：
+//     0xFF 后跟块数据 (末块按剩余长度)        新块
+//     n (0~254)                              复用设备上一次数据的第n块 (只用于完整块)
+// 设备端解码参考ble_delta_decode()
+
+#define BLE_DELTA_BLOCK 64          // 块长度，与原A3数据段相同
+#define BLE_DELTA_LITERAL 0xFF      // 新块标记
+#define BLE_DELTA_MAX_BLOCKS 255    // 可被引用的块数 (块序号只有一个字节)
+#define BLE_DELTA_INDEX_SIZE 512    // 块哈希表大小 (2的幂，大于BLE_DELTA_MAX_BLOCKS)
+
+// 设备已持有数据的记录，每个会话一份
+typedef struct {
+    uint8_t* data;          // 设备上一次完整收到的数据拷贝
+    size_t len;
+    size_t capacity;
+    bool valid;             // 设备持有的数据已知
+    struct {
+        uint64_t hash;
+        uint8_t block;
+        bool used;
+    } index[BLE_DELTA_INDEX_SIZE];  // 块内容哈希 -> 块序号
+} ble_delta_cache_t;
+
+void ble_delta_cache_init(ble_delta_cache_t* cache);
+void ble_delta_cache_free(ble_delta_cache_t* cache);
+// 设备状态未知 (上传失败、重新连接)，下一次上传完整发送
+void ble_delta_cache_invalidate(ble_delta_cache_t* cache);
+// 上传成功后记录设备持有的数据，内存不足时记录失效并返回false
+bool ble_delta_cache_update(ble_delta_cache_t* cache, const uint8_t* data, size_t len);
+
+// 按记录编码差分数据，返回差分长度；记录无效或dst放不下时返回0
+// dst_cap小于len时，返回0即表示差分不划算
+size_t ble_delta_encode(const ble_delta_cache_t* cache, const uint8_t* src, size_t len,
+                        uint8_t* dst, size_t dst_cap);
+
+// 以base为设备上一次的数据还原差分，返回还原后长度；数据格式错误或dst放不下时返回0
+size_t ble_delta_decode(const uint8_t* base, size_t base_len, const uint8_t* src, size_t src_len,
+                        uint8_t* dst, size_t dst_cap);
+
+#endif  /* BLE_DELTA_H */
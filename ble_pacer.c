@@ -0,0 +1,101 @@
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include "ble_pacer.h"
+
+#define NSEC_PER_SEC 1000000000LL
+
+static int64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+// 休眠到绝对时间deadline_ns，被信号打断时继续休眠
+static void sleep_until(int64_t deadline_ns) {
+    struct timespec ts = {
+        .tv_sec = deadline_ns / NSEC_PER_SEC,
+        .tv_nsec = deadline_ns % NSEC_PER_SEC,
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+// 按经过的时间补充令牌，不超过桶容量
+static void refill(ble_pacer_t* pacer, int64_t now_ns) {
+    pacer->tokens += (double)(now_ns - pacer->refill_ns) * pacer->rate / NSEC_PER_SEC;
+    if (pacer->tokens > pacer->burst) {
+        pacer->tokens = pacer->burst;
+    }
+    pacer->refill_ns = now_ns;
+}
+
+void ble_pacer_init(ble_pacer_t* pacer, ble_pacer_unit_t unit, double rate, double burst) {
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->unit = unit;
+    pacer->rate = (rate > 0) ? rate : 0;
+    pacer->burst = (burst >= 1) ? burst : 1;
+    pacer->tokens = pacer->burst;
+    pacer->refill_ns = monotonic_ns();
+}
+
+void ble_pacer_wait(ble_pacer_t* pacer, size_t len) {
+    double cost = (pacer->unit == BLE_PACER_PACKETS) ? 1.0 : (double)len;
+    int64_t now = monotonic_ns();
+
+    if (pacer->rate > 0) {
+        refill(pacer, now);
+        // 超过桶容量的发送只需等桶满，多出的部分记为欠账
+        double need = (cost < pacer->burst) ? cost : pacer->burst;
+        if (pacer->tokens < need) {
+            int64_t deadline = pacer->refill_ns +
+                               (int64_t)ceil((need - pacer->tokens) * NSEC_PER_SEC / pacer->rate);
+            sleep_until(deadline);
+            now = monotonic_ns();
+            // 令牌按截止时间补充，唤醒延迟不计入，否则桶满时延迟期间的令牌被截掉，速率偏低
+            pacer->tokens = need;
+            pacer->refill_ns = deadline;
+
+            double late = (double)(now - deadline);
+            pacer->late_sum_ns += late;
+            if (late > pacer->late_max_ns) {
+                pacer->late_max_ns = late;
+            }
+            pacer->sleeps++;
+        }
+        pacer->tokens -= cost;
+    }
+
+    // 统计发送间隔
+    if (pacer->sends == 0) {
+        pacer->start_ns = now;
+    } else {
+        double interval = (double)(now - pacer->last_send_ns);
+        double delta = interval - pacer->interval_mean_ns;
+        pacer->interval_mean_ns += delta / (double)pacer->sends;
+        pacer->interval_m2 += delta * (interval - pacer->interval_mean_ns);
+    }
+    pacer->last_send_ns = now;
+    pacer->sends++;
+    pacer->last_units = (uint64_t)cost;
+    pacer->units += pacer->last_units;
+}
+
+void ble_pacer_report(const ble_pacer_t* pacer, ble_pacer_report_t* report) {
+    memset(report, 0, sizeof(*report));
+    report->sends = pacer->sends;
+    report->units = pacer->units;
+    if (pacer->sends >= 2) {
+        // n次发送之间有n-1个间隔，最后一次发送的数据在统计时间之外
+        report->elapsed_sec = (double)(pacer->last_send_ns - pacer->start_ns) / NSEC_PER_SEC;
+        report->interval_mean_us = pacer->interval_mean_ns / 1000.0;
+        report->interval_jitter_us = sqrt(pacer->interval_m2 / (double)(pacer->sends - 1)) / 1000.0;
+        if (report->elapsed_sec > 0) {
+            report->rate = (double)(pacer->units - pacer->last_units) / report->elapsed_sec;
+        }
+    }
+    if (pacer->sleeps > 0) {
+        report->late_mean_us = pacer->late_sum_ns / (double)pacer->sleeps / 1000.0;
+        report->late_max_us = pacer->late_max_ns / 1000.0;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef BLE_PACER_H
+
+#define BLE_PACER_H
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// 发送节奏控制：令牌桶，按CLOCK_MONOTONIC的绝对截止时间休眠 (clock_nanosleep TIMER_ABSTIME)
+// 截止时间由桶状态直接算出，写入耗时和休眠误差不会累积，长时间的平均速率等于设定值
+// 桶容量(突发量)允许空闲后连续发送，超过桶容量的单次发送按欠账处理，之后的发送相应推迟
+
+typedef enum {
+    BLE_PACER_BYTES = 0,    // 速率单位为字节/秒
+    BLE_PACER_PACKETS       // 速率单位为包/秒
+} ble_pacer_unit_t;
+
+typedef struct {
+    ble_pacer_unit_t unit;
+    double rate;                // 每秒令牌数，0表示不限速
+    double burst;               // 桶容量 (令牌数)，至少为1
+    double tokens;              // 当前令牌数，可为负 (欠账)
+    int64_t refill_ns;          // 上次补充令牌的时间
+
+    // 统计
+    int64_t start_ns;           // 第一次发送的时间
+    int64_t last_send_ns;       // 上一次发送的时间
+    uint64_t sends;             // 发送次数
+    uint64_t units;             // 发送的令牌数 (字节或包)
+    uint64_t last_units;        // 最后一次发送的令牌数，不计入实际速率
+    double interval_mean_ns;    // 发送间隔均值 (Welford)
+    double interval_m2;         // 发送间隔平方差累计
+    double late_sum_ns;         // 唤醒晚于截止时间的累计
+    double late_max_ns;
+    uint64_t sleeps;            // 需要休眠的次数
+} ble_pacer_t;
+
+// 节奏统计
+typedef struct {
+    double elapsed_sec;         // 第一次到最后一次发送的时间
+    uint64_t sends;
+    uint64_t units;
+    double rate;                // 实际速率 (令牌/秒)
+    double interval_mean_us;    // 发送间隔均值
+    double interval_jitter_us;  // 发送间隔标准差
+    double late_mean_us;        // 唤醒晚于截止时间的均值
+    double late_max_us;         // 唤醒晚于截止时间的最大值
+} ble_pacer_report_t;
+
+// 初始化，桶初始为满
+void ble_pacer_init(ble_pacer_t* pacer, ble_pacer_unit_t unit, double rate, double burst);
+
+// 等到可以发送len字节的数据再返回 (包模式下每次消耗1个令牌)
+void ble_pacer_wait(ble_pacer_t* pacer, size_t len);
+
+// 读取统计
+void ble_pacer_report(const ble_pacer_t* pacer, ble_pacer_report_t* report);
+
+#endif  /* BLE_PACER_H */
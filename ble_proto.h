@@ -0,0 +1,173 @@
+#ifndef BLE_PROTO_H
+
+#define BLE_PROTO_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "ble_checksum.h"
+
+// 协议帧编解码：每条命令只写一张字段表，由同一张表生成
+//   ble_cmd_xx_t         程序中使用的结构体 (字段 + checksum)
+//   ble_xx_wire_t        线上布局，字段都是uint8_t数组，没有填充
+//   BLE_XX_LEN           帧长
+//   BLE_XX_OFF(字段)      字段偏移
+//   ble_xx_encode()      编码并计算校验和，返回帧长，缓冲区不够时返回0
+//   ble_xx_decode()      检查帧长和校验和后解码
+// 全部是static inline，偏移和长度都是编译期常量，编码与手写赋值一样没有额外开销
+//
+// 字段表格式: F(T, 类型, 名称, 个数)，类型为U8 / U16 (大端序，高字节在前) / BYTES (个数为字节数)
+// 字段表中的注释只能用 /* */，// 会吞掉行尾的续行符
+// 校验和固定是帧尾2字节 (大端序)，校验范围与设备固件一致，单独给出起点和长度
+
+// 字段类型的结构体成员
+#define BLE_FIELD_TYPE_U8(name, n)      uint8_t name;
+#define BLE_FIELD_TYPE_U16(name, n)     uint16_t name;
+#define BLE_FIELD_TYPE_BYTES(name, n)   uint8_t name[n];
+#define BLE_FIELD_MEMBER(T, kind, name, n) BLE_FIELD_TYPE_##kind(name, n)
+
+// 字段类型的线上字节数
+#define BLE_FIELD_SIZE_U8(n)            1
+#define BLE_FIELD_SIZE_U16(n)           2
+#define BLE_FIELD_SIZE_BYTES(n)         (n)
+#define BLE_FIELD_WIRE(T, kind, name, n) uint8_t name[BLE_FIELD_SIZE_##kind(n)];
+
+static inline void ble_put_u16(uint8_t* p, uint16_t value) {
+    p[0] = (value >> 8) & 0xFF;
+    p[1] = value & 0xFF;
+}
+
+static inline uint16_t ble_get_u16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+// 字段编码/解码，p为字段在帧中的位置
+#define BLE_FIELD_PUT_U8(p, v, n)       ((p)[0] = (v))
+#define BLE_FIELD_PUT_U16(p, v, n)      ble_put_u16((p), (v))
+#define BLE_FIELD_PUT_BYTES(p, v, n)    memcpy((p), (v), (n))
+#define BLE_FIELD_GET_U8(p, v, n)       ((v) = (p)[0])
+#define BLE_FIELD_GET_U16(p, v, n)      ((v) = ble_get_u16(p))
+#define BLE_FIELD_GET_BYTES(p, v, n)    memcpy((v), (p), (n))
+
+#define BLE_FIELD_ENCODE(T, kind, name, n) \
+    BLE_FIELD_PUT_##kind(buffer + offsetof(ble_##T##_wire_t, name), msg->name, n);
+#define BLE_FIELD_DECODE(T, kind, name, n) \
+    BLE_FIELD_GET_##kind(buffer + offsetof(ble_##T##_wire_t, name), msg->name, n);
+
+// 带校验和的命令帧 (主机发往设备)
+#define BLE_DEFINE_FRAME(T, FIELDS, checksum_start, checksum_len)                                   \
+    typedef struct {                                                                                \
+        FIELDS(BLE_FIELD_MEMBER, T)                                                                 \
+        uint16_t checksum;                                                                          \
+    } ble_cmd_##T##_t;                                                                              \
+                                                                                                    \
+    typedef struct {                                                                                \
+        FIELDS(BLE_FIELD_WIRE, T)                                                                   \
+        uint8_t checksum[2];                                                                        \
+    } ble_##T##_wire_t;                                                                             \
+                                                                                                    \
+    _Static_assert((checksum_start) + (checksum_len) <= offsetof(ble_##T##_wire_t, checksum),       \
+                   #T "校验范围超出帧头");                                                           \
+                                                                                                    \
+    static inline size_t ble_##T##_encode(ble_cmd_##T##_t* msg, uint8_t* buffer, size_t buffer_len) { \
+        if (buffer_len < sizeof(ble_##T##_wire_t)) return 0;                                        \
+        FIELDS(BLE_FIELD_ENCODE, T)                                                                 \
+        msg->checksum = ble_checksum(buffer + (checksum_start), (checksum_len));                    \
+        ble_put_u16(buffer + offsetof(ble_##T##_wire_t, checksum), msg->checksum);                  \
+        return sizeof(ble_##T##_wire_t);                                                            \
+    }                                                                                               \
+                                                                                                    \
+    static inline bool ble_##T##_decode(const uint8_t* buffer, size_t len, ble_cmd_##T##_t* msg) {  \
+        if (len != sizeof(ble_##T##_wire_t)) return false;                                          \
+        msg->checksum = ble_get_u16(buffer + offsetof(ble_##T##_wire_t, checksum));                 \
+        if (msg->checksum != ble_checksum(buffer + (checksum_start), (checksum_len))) return false; \
+        FIELDS(BLE_FIELD_DECODE, T)                                                                 \
+        return true;                                                                                \
+    }
+
+// 设备回复 (通知)：没有校验和，字段可以省略，只解码完整收到的字段
+// ble_xx_decode()返回解码的字段数，未收到的字段为0
+#define BLE_FIELD_DECODE_IF_PRESENT(T, kind, name, n)                                               \
+    if (len >= offsetof(ble_##T##_wire_t, name) + BLE_FIELD_SIZE_##kind(n)) {                       \
+        BLE_FIELD_DECODE(T, kind, name, n)                                                          \
+        fields++;                                                                                   \
+    }
+
+#define BLE_DEFINE_REPLY(T, FIELDS)                                                                 \
+    typedef struct {                                                                                \
+        FIELDS(BLE_FIELD_MEMBER, T)                                                                 \
+    } ble_##T##_t;                                                                                  \
+                                                                                                    \
+    typedef struct {                                                                                \
+        FIELDS(BLE_FIELD_WIRE, T)                                                                   \
+    } ble_##T##_wire_t;                                                                             \
+                                                                                                    \
+    static inline int ble_##T##_decode(const uint8_t* buffer, size_t len, ble_##T##_t* msg) {       \
+        int fields = 0;                                                                             \
+        memset(msg, 0, sizeof(*msg));                                                               \
+        FIELDS(BLE_FIELD_DECODE_IF_PRESENT, T)                                                      \
+        return fields;                                                                              \
+    }
+
+#define BLE_OFF(T, field) offsetof(ble_##T##_wire_t, field)
+
+
+// ---- 协议定义 ----
+
+// A0命令：调速
+#define BLE_A0_FIELDS(F, T)                                                                         \
+    F(T, U8,    cmd,            1)      /* 命令字 (0xA0) */                                          \
+    F(T, U8,    gear,           1)      /* 档位 (0x1C 等) */
+BLE_DEFINE_FRAME(a0, BLE_A0_FIELDS, 0, BLE_OFF(a0, checksum))
+
+// A1命令：基础信息
+#define BLE_A1_FIELDS(F, T)                                                                         \
+    F(T, U8,    cmd,            1)      /* 命令字 (0xA1) */                                          \
+    F(T, U8,    play_mode,      1)      /* 播放模式 */                                               \
+    F(T, U8,    total_lists,    1)      /* 总列表数 */                                               \
+    F(T, U8,    current_list,   1)      /* 当前列表 */                                               \
+    F(T, U8,    effect_count,   1)      /* 效果数目 */                                               \
+    F(T, U8,    current_effect, 1)      /* 当前列表效果序号 */
+BLE_DEFINE_FRAME(a1, BLE_A1_FIELDS, 0, BLE_OFF(a1, checksum))
+
+// A2命令：包头
+// 校验范围是前20字节，不含type_list最后一个字节 (与设备固件一致，不能改)
+#define BLE_A2_FIELDS(F, T)                                                                         \
+    F(T, U8,    cmd,            1)      /* 命令字 (0xA2) */                                          \
+    F(T, U16,   total_bytes,    1)      /* 总字节数 (大端序) */                                      \
+    F(T, U8,    total_packets,  1)      /* 总包数 */                                                 \
+    F(T, U8,    char_len,       1)      /* 总字符数，高两位为A2_FLAG_* */                            \
+    F(T, BYTES, type_list,      16)     /* 每个字符的类型 */
+BLE_DEFINE_FRAME(a2, BLE_A2_FIELDS, 0, 20)
+
+// A3命令：固定64字节数据段的旧格式，校验只覆盖数据段
+// 变长A3包 (encode_a3_packet) 的包头与这里的前3个字段相同
+#define BLE_A3_FIELDS(F, T)                                                                         \
+    F(T, U8,    cmd,            1)      /* 命令字 (0xA3) */                                          \
+    F(T, U8,    packet_num,     1)      /* 当前包序号 (从1开始) */                                   \
+    F(T, U8,    data_len,       1)      /* 本包有效数据长度 */                                       \
+    F(T, BYTES, data,           64)     /* 数据段，不足64字节补0 */
+BLE_DEFINE_FRAME(a3, BLE_A3_FIELDS, BLE_OFF(a3, data), 64)
+
+// 设备反馈 (0xffe4通知)
+#define BLE_REPLY_FIELDS(F, T)                                                                      \
+    F(T, U8,    result,         1)      /* 0x01成功，其他按失败处理 */                               \
+    F(T, U8,    packet_num,     1)      /* 对应的A3包序号 (可选) */
+BLE_DEFINE_REPLY(reply, BLE_REPLY_FIELDS)
+
+#define BLE_A0_LEN sizeof(ble_a0_wire_t)
+#define BLE_A1_LEN sizeof(ble_a1_wire_t)
+#define BLE_A2_LEN sizeof(ble_a2_wire_t)
+#define BLE_A3_LEN sizeof(ble_a3_wire_t)
+#define BLE_REPLY_OK 0x01
+
+// 线上格式由设备固件决定，字段表改动导致帧长变化时编译失败
+_Static_assert(BLE_A0_LEN == 4, "A0帧长必须为4");
+_Static_assert(BLE_A1_LEN == 8, "A1帧长必须为8");
+_Static_assert(BLE_A2_LEN == 23, "A2帧长必须为23");
+_Static_assert(BLE_A3_LEN == 69, "A3帧长必须为69");
+_Static_assert(BLE_OFF(a3, data) == 3, "A3包头必须为3字节");
+
+#endif  /* BLE_PROTO_H */
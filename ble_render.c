@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iconv.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ble_render.h"
+
+#define ENTRY_NONE UINT32_MAX
+#define ASC16_MIN_LEN (128 * BLE_GLYPH_HALF_BYTES)  // 至少包含ASCII
+#define GB2312_ROW_CHARS 94
+#define REPLACEMENT_CHAR '?'
+
+// 缓存的字模，按码点查找，按最近使用排序
+typedef struct {
+    uint32_t codepoint;
+    uint32_t hash_next;     // 同一个哈希桶的下一个字模
+    uint32_t prev;          // LRU链表，head为最近使用
+    uint32_t next;
+    uint8_t type;           // BLE_GLYPH_HALF / BLE_GLYPH_FULL
+    uint8_t bitmap[BLE_GLYPH_FULL_BYTES];
+} glyph_entry_t;
+
+struct ble_font {
+    const uint8_t* hzk16;
+    size_t hzk16_len;
+    const uint8_t* asc16;
+    size_t asc16_len;
+    iconv_t to_gb2312;      // 码点转GB2312区位码，只在持有lock时使用
+
+    pthread_mutex_t lock;
+    glyph_entry_t* entries;
+    size_t cache_size;
+    size_t used;
+    uint32_t* buckets;      // 哈希桶，保存字模下标
+    size_t bucket_mask;
+    uint32_t lru_head;
+    uint32_t lru_tail;
+    ble_render_stats_t stats;
+};
+
+// 只读映射整个文件，失败时返回NULL
+static const uint8_t* map_file(const char* path, size_t* len) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "无法打开字库 %s\n", path);
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "无法映射字库 %s\n", path);
+        return NULL;
+    }
+    *len = (size_t)st.st_size;
+    return data;
+}
+
+// 解码一个UTF-8字符并前移*text，非法序列返回U+FFFD并跳过一个字节
+static uint32_t utf8_next(const char** text) {
+    const uint8_t* p = (const uint8_t*)*text;
+    uint32_t cp;
+    int extra;
+
+    if (p[0] < 0x80) {
+        *text += 1;
+        return p[0];
+    } else if ((p[0] & 0xE0) == 0xC0) {
+        cp = p[0] & 0x1F;
+        extra = 1;
+    } else if ((p[0] & 0xF0) == 0xE0) {
+        cp = p[0] & 0x0F;
+        extra = 2;
+    } else if ((p[0] & 0xF8) == 0xF0) {
+        cp = p[0] & 0x07;
+        extra = 3;
+    } else {
+        *text += 1;
+        return 0xFFFD;
+    }
+    for (int i = 1; i <= extra; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            *text += 1;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (p[i] & 0x3F);
+    }
+    *text += 1 + extra;
+    return cp;
+}
+
+// 逐行点阵转为设备的逐列分页点阵
+// rows: 16行，每行row_bytes字节，高位在左；out: 上半页width字节，下半页width字节，低位在上
+static void rows_to_columns(const uint8_t* rows, int row_bytes, int width, uint8_t* out) {
+    memset(out, 0, (size_t)width * 2);
+    for (int row = 0; row < 16; row++) {
+        uint8_t* page = out + (row < 8 ? 0 : width);
+        uint8_t bit = (uint8_t)(1 << (row & 7));
+        for (int col = 0; col < width; col++) {
+            if (rows[row * row_bytes + col / 8] & (0x80 >> (col & 7))) {
+                page[col] |= bit;
+            }
+        }
+    }
+}
+
+// 从ASC16取半角字模，码点超出字库时返回false
+static bool load_half(const ble_font_t* font, uint32_t codepoint, glyph_entry_t* entry) {
+    size_t offset = (size_t)codepoint * BLE_GLYPH_HALF_BYTES;
+    if (offset + BLE_GLYPH_HALF_BYTES > font->asc16_len) {
+        return false;
+    }
+    rows_to_columns(font->asc16 + offset, 1, 8, entry->bitmap);
+    entry->type = BLE_GLYPH_HALF;
+    return true;
+}
+
+// 码点转GB2312后从HZK16取全角字模，字库中没有时返回false
+static bool load_full(ble_font_t* font, uint32_t codepoint, glyph_entry_t* entry) {
+    uint8_t utf32[4] = {
+        (uint8_t)(codepoint >> 24), (uint8_t)(codepoint >> 16), (uint8_t)(codepoint >> 8), (uint8_t)codepoint
+    };
+    uint8_t gb[4];
+    char* in = (char*)utf32;
+    char* out = (char*)gb;
+    size_t in_left = sizeof(utf32);
+    size_t out_left = sizeof(gb);
+
+    if (font->hzk16 == NULL) {
+        return false;
+    }
+    iconv(font->to_gb2312, NULL, NULL, NULL, NULL);
+    if (iconv(font->to_gb2312, &in, &in_left, &out, &out_left) == (size_t)-1 ||
+        sizeof(gb) - out_left != 2 || gb[0] < 0xA1 || gb[1] < 0xA1) {
+        return false;
+    }
+
+    size_t index = (size_t)(gb[0] - 0xA1) * GB2312_ROW_CHARS + (gb[1] - 0xA1);
+    size_t offset = index * BLE_GLYPH_FULL_BYTES;
+    if (offset + BLE_GLYPH_FULL_BYTES > font->hzk16_len) {
+        return false;
+    }
+    rows_to_columns(font->hzk16 + offset, 2, 16, entry->bitmap);
+    entry->type = BLE_GLYPH_FULL;
+    return true;
+}
+
+static size_t bucket_of(const ble_font_t* font, uint32_t codepoint) {
+    return (codepoint * 2654435761u) & font->bucket_mask;
+}
+
+static void lru_unlink(ble_font_t* font, uint32_t index) {
+    glyph_entry_t* entry = &font->entries[index];
+    if (entry->prev != ENTRY_NONE) {
+        font->entries[entry->prev].next = entry->next;
+    } else {
+        font->lru_head = entry->next;
+    }
+    if (entry->next != ENTRY_NONE) {
+        font->entries[entry->next].prev = entry->prev;
+    } else {
+        font->lru_tail = entry->prev;
+    }
+}
+
+static void lru_push_front(ble_font_t* font, uint32_t index) {
+    glyph_entry_t* entry = &font->entries[index];
+    entry->prev = ENTRY_NONE;
+    entry->next = font->lru_head;
+    if (font->lru_head != ENTRY_NONE) {
+        font->entries[font->lru_head].prev = index;
+    } else {
+        font->lru_tail = index;
+    }
+    font->lru_head = index;
+}
+
+static void bucket_remove(ble_font_t* font, uint32_t index) {
+    uint32_t* link = &font->buckets[bucket_of(font, font->entries[index].codepoint)];
+    while (*link != index) {
+        link = &font->entries[*link].hash_next;
+    }
+    *link = font->entries[index].hash_next;
+}
+
+// 查找字模，未命中时从字库转换并替换最久未用的字模 (调用者需持有font->lock)
+static const glyph_entry_t* glyph_lookup(ble_font_t* font, uint32_t codepoint) {
+    size_t bucket = bucket_of(font, codepoint);
+
+    for (uint32_t i = font->buckets[bucket]; i != ENTRY_NONE; i = font->entries[i].hash_next) {
+        if (font->entries[i].codepoint == codepoint) {
+            if (font->lru_head != i) {
+                lru_unlink(font, i);
+                lru_push_front(font, i);
+            }
+            return &font->entries[i];
+        }
+    }
+
+    uint32_t index;
+    if (font->used < font->cache_size) {
+        index = (uint32_t)font->used++;
+    } else {
+        index = font->lru_tail;
+        lru_unlink(font, index);
+        bucket_remove(font, index);
+    }
+
+    glyph_entry_t* entry = &font->entries[index];
+    bool found = (codepoint < 0x80) ? load_half(font, codepoint, entry) : load_full(font, codepoint, entry);
+    if (!found) {
+        // 字库中没有的字符显示为'?'，同样缓存，避免每次重新转换
+        load_half(font, REPLACEMENT_CHAR, entry);
+        font->stats.missing++;
+    }
+    font->stats.misses++;
+
+    entry->codepoint = codepoint;
+    entry->hash_next = font->buckets[bucket];
+    font->buckets[bucket] = index;
+    lru_push_front(font, index);
+    return entry;
+}
+
+// 渲染一条文字 (调用者需持有font->lock)
+static int render_locked(ble_font_t* font, const char* text, ble_render_msg_t* msg) {
+    const char* p = text;
+    int chars = 0;
+    size_t len = 0;
+
+    memset(msg->type_list, 0, sizeof(msg->type_list));
+    while (*p != '\0' && chars < BLE_RENDER_MAX_CHARS) {
+        const glyph_entry_t* glyph = glyph_lookup(font, utf8_next(&p));
+        size_t size = (glyph->type == BLE_GLYPH_FULL) ? BLE_GLYPH_FULL_BYTES : BLE_GLYPH_HALF_BYTES;
+        memcpy(msg->data + len, glyph->bitmap, size);
+        len += size;
+        msg->type_list[chars++] = glyph->type;
+    }
+    font->stats.glyphs += (unsigned long)chars;
+
+    msg->char_len = (uint8_t)chars;
+    msg->data_len = len;
+    msg->consumed = (size_t)(p - text);
+    return chars;
+}
+
+ble_font_t* ble_font_open(const char* hzk16_path, const char* asc16_path, size_t cache_size) {
+    ble_font_t* font = calloc(1, sizeof(ble_font_t));
+    if (font == NULL) {
+        return NULL;
+    }
+    font->to_gb2312 = (iconv_t)-1;
+    if (cache_size == 0) {
+        cache_size = BLE_RENDER_CACHE_SIZE;
+    }
+
+    font->asc16 = map_file(asc16_path, &font->asc16_len);
+    if (font->asc16 == NULL || font->asc16_len < ASC16_MIN_LEN) {
+        fprintf(stderr, "ASC16字库无效: %s\n", asc16_path);
+        goto ERROR;
+    }
+    if (hzk16_path != NULL) {
+        font->hzk16 = map_file(hzk16_path, &font->hzk16_len);
+        if (font->hzk16 == NULL) {
+            goto ERROR;
+        }
+        font->to_gb2312 = iconv_open("GB2312", "UTF-32BE");
+        if (font->to_gb2312 == (iconv_t)-1) {
+            fprintf(stderr, "系统不支持GB2312转换\n");
+            goto ERROR;
+        }
+    }
+
+    // 哈希桶数取不小于2倍缓存大小的2的幂
+    size_t buckets = 1;
+    while (buckets < cache_size * 2) {
+        buckets <<= 1;
+    }
+    font->entries = calloc(cache_size, sizeof(glyph_entry_t));
+    font->buckets = malloc(buckets * sizeof(uint32_t));
+    if (font->entries == NULL || font->buckets == NULL) {
+        goto ERROR;
+    }
+    memset(font->buckets, 0xFF, buckets * sizeof(uint32_t));
+    font->bucket_mask = buckets - 1;
+    font->cache_size = cache_size;
+    font->lru_head = ENTRY_NONE;
+    font->lru_tail = ENTRY_NONE;
+    pthread_mutex_init(&font->lock, NULL);
+    return font;
+
+ERROR:
+    free(font->entries);
+    free(font->buckets);
+    if (font->to_gb2312 != (iconv_t)-1) {
+        iconv_close(font->to_gb2312);
+    }
+    if (font->hzk16) {
+        munmap((void*)font->hzk16, font->hzk16_len);
+    }
+    if (font->asc16) {
+        munmap((void*)font->asc16, font->asc16_len);
+    }
+    free(font);
+    return NULL;
+}
+
+void ble_font_close(ble_font_t* font) {
+    if (font == NULL) {
+        return;
+    }
+    pthread_mutex_destroy(&font->lock);
+    free(font->entries);
+    free(font->buckets);
+    if (font->to_gb2312 != (iconv_t)-1) {
+        iconv_close(font->to_gb2312);
+    }
+    if (font->hzk16) {
+        munmap((void*)font->hzk16, font->hzk16_len);
+    }
+    munmap((void*)font->asc16, font->asc16_len);
+    free(font);
+}
+
+int ble_render_text(ble_font_t* font, const char* text, ble_render_msg_t* msg) {
+    pthread_mutex_lock(&font->lock);
+    int chars = render_locked(font, text, msg);
+    pthread_mutex_unlock(&font->lock);
+    return chars;
+}
+
+size_t ble_render_batch(ble_font_t* font, const char* const* texts, size_t count, ble_render_msg_t* msgs) {
+    size_t rendered = 0;
+
+    pthread_mutex_lock(&font->lock);
+    for (size_t i = 0; i < count; i++) {
+        if (render_locked(font, texts[i], &msgs[i]) > 0) {
+            rendered++;
+        }
+    }
+    pthread_mutex_unlock(&font->lock);
+    return rendered;
+}
+
+void ble_render_get_stats(ble_font_t* font, ble_render_stats_t* stats) {
+    pthread_mutex_lock(&font->lock);
+    *stats = font->stats;
+    pthread_mutex_unlock(&font->lock);
+}
@@ -0,0 +1,54 @@
+#ifndef BLE_RENDER_H
+
+#define BLE_RENDER_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 文字渲染：UTF-8文字转换为A2的字符数/类型列表和A3点阵数据
+// 字库为HZK16 (GB2312 16x16) 和 ASC16 (8x16)，打开时只做内存映射，按需读取
+// 字库是逐行点阵，设备要的是逐列分页点阵 (上8行一页、下8行一页，低位在上)，
+// 转换后的字模放在LRU缓存中，常用字只转换一次
+
+#define BLE_GLYPH_HALF 0x00         // type_list: 8x16半角字符
+#define BLE_GLYPH_FULL 0x01         // type_list: 16x16全角字符
+#define BLE_GLYPH_HALF_BYTES 16
+#define BLE_GLYPH_FULL_BYTES 32
+#define BLE_RENDER_MAX_CHARS 16     // 一次上传的字符数 (A2 type_list长度)
+#define BLE_RENDER_CACHE_SIZE 1024  // 默认缓存的字模数
+
+// 一条渲染结果，可直接用于一次A2+A3上传
+typedef struct {
+    uint8_t char_len;                       // 字符数
+    uint8_t type_list[BLE_RENDER_MAX_CHARS];
+    size_t data_len;                        // A3数据长度
+    uint8_t data[BLE_RENDER_MAX_CHARS * BLE_GLYPH_FULL_BYTES];
+    size_t consumed;                        // 已渲染的UTF-8字节数，文字超过16个字符时从这里继续渲染
+} ble_render_msg_t;
+
+// 渲染统计
+typedef struct {
+    unsigned long glyphs;       // 渲染的字符数
+    unsigned long misses;       // 缓存未命中 (需要从字库转换) 的字符数
+    unsigned long missing;      // 字库中没有、用'?'代替的字符数
+} ble_render_stats_t;
+
+typedef struct ble_font ble_font_t;
+
+// 打开字库，hzk16_path可以为NULL (只渲染ASCII，其他字符显示为'?')
+// cache_size为缓存的字模数，0表示BLE_RENDER_CACHE_SIZE；失败时返回NULL
+ble_font_t* ble_font_open(const char* hzk16_path, const char* asc16_path, size_t cache_size);
+void ble_font_close(ble_font_t* font);
+
+// 渲染一条文字，最多BLE_RENDER_MAX_CHARS个字符；返回渲染的字符数，text为空时返回0
+// 多个线程可以共用同一个字库
+int ble_render_text(ble_font_t* font, const char* text, ble_render_msg_t* msg);
+
+// 批量渲染count条文字，整批只加一次锁；返回成功渲染的条数
+size_t ble_render_batch(ble_font_t* font, const char* const* texts, size_t count, ble_render_msg_t* msgs);
+
+// 读取统计
+void ble_render_get_stats(ble_font_t* font, ble_render_stats_t* stats);
+
+#endif  /* BLE_RENDER_H */
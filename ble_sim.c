@@ -0,0 +1,383 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include "ble_sim.h"
+#include "ble_checksum.h"
+#include "ble_compress.h"
+#include "ble_delta.h"
+
+#define SIM_PENDING_MAX 256     // 同时等待发出的反馈数
+
+// 一帧的检查结果
+typedef enum {
+    SIM_FRAME_OK,
+    SIM_FRAME_BAD,          // 格式或校验错误
+    SIM_FRAME_REJECTED      // 格式正确但设备不支持 (压缩/差分上传)
+} sim_frame_result_t;
+
+// 等待发出的反馈
+typedef struct {
+    struct timespec due;        // 发出时间 (CLOCK_MONOTONIC)
+    uint8_t data[2];
+    size_t len;
+} sim_ack_t;
+
+struct ble_sim {
+    ble_sim_config_t config;
+    ble_session_t* session;
+
+    pthread_t thread;           // 反馈线程，按到期时间发出反馈
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool stopping;
+    unsigned int rand_state;
+
+    sim_ack_t pending[SIM_PENDING_MAX];
+    size_t pending_count;
+
+    // 设备侧的上传接收状态
+    uint8_t expected_packets;   // A2声明的总包数
+    uint16_t expected_bytes;    // A2声明的总字节数
+    bool compressed;            // A2带压缩标志
+    bool delta;                 // A2带差分标志
+    bool received[256];         // 已收到的A3包
+    unsigned int received_count;
+    unsigned long received_bytes;
+    uint8_t packet_data[256][A3_MAX_SEGMENT]; // 已收到的A3数据，收齐后按包序号拼接
+    uint8_t packet_len[256];
+    uint8_t upload[UINT16_MAX];         // 拼接后的上传数据
+    uint8_t decoded[UINT16_MAX];        // 解压后的上传数据
+    uint8_t content[UINT16_MAX];        // 最近一次完整收到的数据，也是下一次差分的基准
+    size_t content_len;                 // 0表示没有
+
+    ble_sim_stats_t stats;
+};
+
+static double sim_random(ble_sim_t* sim) {
+    return (double)rand_r(&sim->rand_state) / ((double)RAND_MAX + 1.0);
+}
+
+static void timespec_add_ms(struct timespec* ts, unsigned int ms) {
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static bool timespec_before(const struct timespec* a, const struct timespec* b) {
+    return (a->tv_sec < b->tv_sec) ||
+           (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+static bool checksum_matches(const uint8_t* data, size_t len, const uint8_t* checksum) {
+    uint16_t sum = ble_checksum(data, len);
+    return checksum[0] == ((sum >> 8) & 0xFF) && checksum[1] == (sum & 0xFF);
+}
+
+// 收齐一次上传：按包序号拼接，依次解压、还原差分后计数 (调用者需持有sim->lock)
+static void sim_complete_upload(ble_sim_t* sim) {
+    uint8_t* data = sim->upload;
+    size_t len = 0;
+
+    for (unsigned int i = 1; i <= sim->expected_packets; i++) {
+        memcpy(sim->upload + len, sim->packet_data[i], sim->packet_len[i]);
+        len += sim->packet_len[i];
+    }
+    sim->stats.upload_bytes += len;
+    if (sim->compressed) {
+        len = ble_decompress(data, len, sim->decoded, sizeof(sim->decoded));
+        data = sim->decoded;
+        if (len == 0) {
+            fprintf(stderr, "模拟设备: 压缩数据解码失败\n");
+            sim->content_len = 0;
+            return;
+        }
+        sim->stats.compressed_uploads++;
+    }
+    if (sim->delta) {
+        uint8_t* out = (data == sim->upload) ? sim->decoded : sim->upload;
+        len = ble_delta_decode(sim->content, sim->content_len, data, len, out, UINT16_MAX);
+        data = out;
+        if (len == 0) {
+            fprintf(stderr, "模拟设备: 差分数据还原失败\n");
+            sim->content_len = 0;
+            return;
+        }
+        sim->stats.delta_uploads++;
+    }
+    memcpy(sim->content, data, len);
+    sim->content_len = len;
+    sim->stats.uploads++;
+    sim->stats.payload_bytes += len;
+}
+
+// 按协议检查一帧，A2/A3同时更新接收状态 (调用者需持有sim->lock)
+// *packet_num返回A3包序号，其他帧为0
+static sim_frame_result_t sim_parse_frame(ble_sim_t* sim, const uint8_t* data, size_t len, uint8_t* packet_num) {
+    *packet_num = 0;
+    if (len == 0) {
+        return SIM_FRAME_BAD;
+    }
+
+    switch (data[0]) {
+    case CMD_A0: {
+        ble_cmd_a0_t a0;
+        return ble_a0_decode(data, len, &a0) ? SIM_FRAME_OK : SIM_FRAME_BAD;
+    }
+    case CMD_A1: {
+        ble_cmd_a1_t a1;
+        return ble_a1_decode(data, len, &a1) ? SIM_FRAME_OK : SIM_FRAME_BAD;
+    }
+    case CMD_A2: {
+        // 帧长和校验范围由ble_proto.h的字段表决定，与build_a2_packet()一致
+        ble_cmd_a2_t a2;
+        if (!ble_a2_decode(data, len, &a2)) {
+            return SIM_FRAME_BAD;
+        }
+        // 没有上一次的数据时无法还原差分，与不支持差分一样拒绝
+        if (((a2.char_len & A2_FLAG_COMPRESSED) && !sim->config.compression) ||
+            ((a2.char_len & A2_FLAG_DELTA) && (!sim->config.delta || sim->content_len == 0))) {
+            sim->stats.rejected_a2++;
+            return SIM_FRAME_REJECTED;
+        }
+        sim->expected_bytes = a2.total_bytes;
+        sim->expected_packets = a2.total_packets;
+        sim->compressed = (a2.char_len & A2_FLAG_COMPRESSED) != 0;
+        sim->delta = (a2.char_len & A2_FLAG_DELTA) != 0;
+        memset(sim->received, 0, sizeof(sim->received));
+        sim->received_count = 0;
+        sim->received_bytes = 0;
+        return SIM_FRAME_OK;
+    }
+    case CMD_A3: {
+        if (len < A3_HEADER_LEN + A3_CHECKSUM_LEN) {
+            return SIM_FRAME_BAD;
+        }
+        size_t data_len = data[2];
+        // 兼容固定64字节数据段的旧格式 (末包data_len小于64，但仍带64字节数据)
+        size_t segment_len = (len == A3_HEADER_LEN + A3_LEGACY_SEGMENT + A3_CHECKSUM_LEN) ?
+                             A3_LEGACY_SEGMENT : data_len;
+        if (len != A3_HEADER_LEN + segment_len + A3_CHECKSUM_LEN || data_len > segment_len ||
+            !checksum_matches(data + A3_HEADER_LEN, segment_len, data + A3_HEADER_LEN + segment_len)) {
+            return SIM_FRAME_BAD;
+        }
+        *packet_num = data[1];
+        sim->stats.a3_bytes += data_len;
+        if (data[1] >= 1 && data[1] <= sim->expected_packets && !sim->received[data[1]]) {
+            sim->received[data[1]] = true;
+            sim->received_count++;
+            sim->received_bytes += data_len;
+            memcpy(sim->packet_data[data[1]], data + A3_HEADER_LEN, data_len);
+            sim->packet_len[data[1]] = (uint8_t)data_len;
+            if (sim->received_count == sim->expected_packets &&
+                sim->received_bytes == sim->expected_bytes) {
+                sim_complete_upload(sim);
+            }
+        }
+        return SIM_FRAME_OK;
+    }
+    default:
+        return SIM_FRAME_BAD;
+    }
+}
+
+// 设备收到一帧：检查后按配置安排反馈
+static void sim_receive_frame(ble_sim_t* sim, const uint8_t* data, size_t len) {
+    uint8_t packet_num;
+
+    pthread_mutex_lock(&sim->lock);
+    sim->stats.frames++;
+    sim_frame_result_t result = sim_parse_frame(sim, data, len, &packet_num);
+    bool ok = (result == SIM_FRAME_OK);
+    if (result == SIM_FRAME_BAD) {
+        sim->stats.bad_frames++;
+    } else if (ok && sim_random(sim) < sim->config.nak_rate) {
+        ok = false;
+    }
+
+    if (sim_random(sim) < sim->config.ack_loss || sim->pending_count >= SIM_PENDING_MAX) {
+        sim->stats.lost_acks++;
+        pthread_mutex_unlock(&sim->lock);
+        return;
+    }
+
+    sim_ack_t* ack = &sim->pending[sim->pending_count++];
+    unsigned int delay_ms = sim->config.latency_ms;
+    if (sim->config.jitter_ms > 0) {
+        delay_ms += (unsigned int)(sim_random(sim) * (sim->config.jitter_ms + 1));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ack->due);
+    timespec_add_ms(&ack->due, delay_ms);
+    ack->data[0] = ok ? 0x01 : 0x00;
+    ack->data[1] = packet_num;
+    ack->len = (packet_num != 0 && sim->config.ack_packet_num) ? 2 : 1;
+    if (ok) {
+        sim->stats.acks++;
+    } else {
+        sim->stats.naks++;
+    }
+    pthread_cond_signal(&sim->cond);
+    pthread_mutex_unlock(&sim->lock);
+}
+
+// 反馈线程：到期的反馈送回会话，送回时不持有sim->lock
+static void* sim_ack_thread(void* arg) {
+    ble_sim_t* sim = arg;
+
+    pthread_mutex_lock(&sim->lock);
+    while (!sim->stopping) {
+        if (sim->pending_count == 0) {
+            pthread_cond_wait(&sim->cond, &sim->lock);
+            continue;
+        }
+
+        size_t earliest = 0;
+        for (size_t i = 1; i < sim->pending_count; i++) {
+            if (timespec_before(&sim->pending[i].due, &sim->pending[earliest].due)) {
+                earliest = i;
+            }
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (timespec_before(&now, &sim->pending[earliest].due)) {
+            pthread_cond_timedwait(&sim->cond, &sim->lock, &sim->pending[earliest].due);
+            continue;
+        }
+
+        sim_ack_t ack = sim->pending[earliest];
+        sim->pending[earliest] = sim->pending[--sim->pending_count];
+        ble_session_t* session = sim->session;
+        pthread_mutex_unlock(&sim->lock);
+
+        if (session) {
+            ble_session_on_feedback(session, ack.data, ack.len);
+        }
+
+        pthread_mutex_lock(&sim->lock);
+    }
+    pthread_mutex_unlock(&sim->lock);
+    return NULL;
+}
+
+// 传输接口实现
+static int sim_write_req(ble_session_t* session, const uint8_t* data, size_t len) {
+    ble_sim_t* sim = session->transport_ctx;
+
+    // 带响应写入要等ATT写响应返回
+    if (sim->config.write_rtt_ms > 0) {
+        usleep(sim->config.write_rtt_ms * 1000);
+    }
+    sim_receive_frame(sim, data, len);
+    return GATTLIB_SUCCESS;
+}
+
+static int sim_write_cmd(ble_session_t* session, const uint8_t* data, size_t len) {
+    ble_sim_t* sim = session->transport_ctx;
+    uint16_t mtu = sim->config.mtu ? sim->config.mtu : ATT_DEFAULT_LE_MTU;
+
+    // Write Command没有长写入，超过一个PDU的帧会被拒绝
+    if (mtu <= ATT_WRITE_HEADER_LEN || len > (size_t)(mtu - ATT_WRITE_HEADER_LEN)) {
+        return GATTLIB_NOT_SUPPORTED;
+    }
+    sim_receive_frame(sim, data, len);
+    return GATTLIB_SUCCESS;
+}
+
+static int sim_stream_open(ble_session_t* session, gattlib_stream_t** stream, uint16_t* mtu) {
+    ble_sim_t* sim = session->transport_ctx;
+
+    if (sim->config.mtu == 0) {
+        return GATTLIB_NOT_SUPPORTED;
+    }
+    *stream = (gattlib_stream_t*)sim;
+    *mtu = sim->config.mtu;
+    return GATTLIB_SUCCESS;
+}
+
+static int sim_stream_write(ble_session_t* session, gattlib_stream_t* stream, const uint8_t* data, size_t len) {
+    return sim_write_cmd(session, data, len);
+}
+
+static int sim_stream_close(ble_session_t* session, gattlib_stream_t* stream) {
+    return GATTLIB_SUCCESS;
+}
+
+static const ble_transport_ops_t sim_transport = {
+    .write_req = sim_write_req,
+    .write_cmd = sim_write_cmd,
+    .stream_open = sim_stream_open,
+    .stream_write = sim_stream_write,
+    .stream_close = sim_stream_close,
+};
+
+ble_sim_t* ble_sim_create(const ble_sim_config_t* config) {
+    pthread_condattr_t attr;
+    ble_sim_t* sim = calloc(1, sizeof(ble_sim_t));
+    if (sim == NULL) {
+        return NULL;
+    }
+
+    sim->config = *config;
+    sim->rand_state = config->seed;
+    pthread_mutex_init(&sim->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sim->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&sim->thread, NULL, sim_ack_thread, sim) != 0) {
+        pthread_cond_destroy(&sim->cond);
+        pthread_mutex_destroy(&sim->lock);
+        free(sim);
+        return NULL;
+    }
+    return sim;
+}
+
+void ble_sim_attach(ble_sim_t* sim, ble_session_t* session) {
+    pthread_mutex_lock(&sim->lock);
+    sim->session = session;
+    pthread_mutex_unlock(&sim->lock);
+
+    session->transport_ops = &sim_transport;
+    session->transport_ctx = sim;
+}
+
+void ble_sim_destroy(ble_sim_t* sim) {
+    if (sim == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&sim->lock);
+    sim->stopping = true;
+    pthread_cond_signal(&sim->cond);
+    pthread_mutex_unlock(&sim->lock);
+    pthread_join(sim->thread, NULL);
+
+    pthread_cond_destroy(&sim->cond);
+    pthread_mutex_destroy(&sim->lock);
+    free(sim);
+}
+
+void ble_sim_get_stats(ble_sim_t* sim, ble_sim_stats_t* stats) {
+    pthread_mutex_lock(&sim->lock);
+    *stats = sim->stats;
+    pthread_mutex_unlock(&sim->lock);
+}
+
+size_t ble_sim_get_content(ble_sim_t* sim, uint8_t* buffer, size_t buffer_len) {
+    pthread_mutex_lock(&sim->lock);
+    size_t len = sim->content_len;
+    if (len > buffer_len) {
+        len = buffer_len;
+    }
+    memcpy(buffer, sim->content, len);
+    pthread_mutex_unlock(&sim->lock);
+    return len;
+}
@@ -0,0 +1,54 @@
+#ifndef BLE_SIM_H
+
+#define BLE_SIM_H
+
+
+#include "BLE_Bluetooh.h"
+
+// 本地模拟设备：在进程内实现A0–A3协议和0xffe4反馈，不需要真实显示屏
+// 用ble_sim_attach()替换会话的传输接口后，发送函数的行为与真实设备相同
+
+// 模拟参数
+typedef struct {
+    unsigned int latency_ms;    // 设备反馈延迟
+    unsigned int jitter_ms;     // 反馈延迟抖动 (0~jitter_ms 均匀分布)
+    unsigned int write_rtt_ms;  // 带响应写入的ATT往返时间 (写调用阻塞时长)
+    double ack_loss;            // 反馈丢失概率 (0~1)
+    double nak_rate;            // 设备返回失败反馈(0x00)的概率 (0~1)
+    uint16_t mtu;               // ATT MTU，0表示不支持AcquireWrite
+    bool ack_packet_num;        // A3反馈是否带包序号 (data[1])
+    bool compression;           // 固件支持压缩上传，为false时带A2_FLAG_COMPRESSED的A2返回失败反馈
+    bool delta;                 // 固件支持差分上传，为false时带A2_FLAG_DELTA的A2返回失败反馈
+    unsigned int seed;          // 随机数种子，固定后结果可复现
+} ble_sim_config_t;
+
+// 模拟设备统计
+typedef struct {
+    unsigned long frames;       // 收到的帧数
+    unsigned long bad_frames;   // 格式或校验错误的帧数
+    unsigned long acks;         // 发出的成功反馈数
+    unsigned long naks;         // 发出的失败反馈数
+    unsigned long lost_acks;    // 丢弃的反馈数
+    unsigned long a3_bytes;     // 收到的A3数据字节数 (含重发)
+    unsigned long uploads;      // 完整收到的A2+A3上传次数
+    unsigned long upload_bytes; // 完整上传的A3数据字节数 (不含重发)
+    unsigned long compressed_uploads; // 其中压缩上传的次数
+    unsigned long delta_uploads; // 其中差分上传的次数
+    unsigned long rejected_a2;  // 因不支持压缩/差分或没有差分基准而拒绝的A2帧数
+    unsigned long payload_bytes; // 完整上传的数据字节数 (压缩上传按解压后计)
+} ble_sim_stats_t;
+
+typedef struct ble_sim ble_sim_t;
+
+// 创建模拟设备，失败时返回NULL
+ble_sim_t* ble_sim_create(const ble_sim_config_t* config);
+// 把会话的传输接口指向模拟设备，反馈通过ble_session_on_feedback()送回
+void ble_sim_attach(ble_sim_t* sim, ble_session_t* session);
+// 停止反馈线程并释放模拟设备
+void ble_sim_destroy(ble_sim_t* sim);
+// 读取统计
+void ble_sim_get_stats(ble_sim_t* sim, ble_sim_stats_t* stats);
+// 读取设备最近一次完整收到的数据 (压缩/差分已还原)，返回数据长度，没有时返回0
+size_t ble_sim_get_content(ble_sim_t* sim, uint8_t* buffer, size_t buffer_len);
+
+#endif  /* BLE_SIM_H */
@@ -0,0 +1,198 @@
+// 用本地模拟设备测试A2+A3上传的吞吐量和重发行为，不需要真实显示屏
+// 编译: gcc -O2 -DBLE_NO_MAIN -o ble_sim_bench ble_sim_bench.c ble_sim.c BLE_Bluetooh.c ble_checksum.c ble_trace.c
+//       ble_compress.c ble_delta.c $(pkg-config --cflags --libs glib-2.0) -lgattlib -lpthread
+// 所有上传成功且设备完整收到时返回0，上传失败返回1，参数无效或数据超出协议限制返回2，可用于CI回归测试
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "ble_sim.h"
+#include "ble_trace.h"
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char* program) {
+    printf("用法: %s [选项]\n", program);
+    printf("  -l <ms>     设备反馈延迟 (默认20)\n");
+    printf("  -j <ms>     反馈延迟抖动 (默认5)\n");
+    printf("  -R <ms>     带响应写入的ATT往返时间 (默认15)\n");
+    printf("  -a <0~1>    反馈丢失率 (默认0)\n");
+    printf("  -n <0~1>    失败反馈率 (默认0)\n");
+    printf("  -A          模拟A3反馈不带包序号的旧固件 (1字节反馈)\n");
+    printf("  -m <mtu>    ATT MTU，0表示不支持AcquireWrite (默认247)\n");
+    printf("  -w <n>      A3滑动窗口大小 (默认%d)\n", A3_WINDOW_SIZE);
+    printf("  -t <模式>   A3发送方式: req / cmd / stream (默认cmd)\n");
+    printf("  -s <字节>   每次上传的数据长度 (默认4096)\n");
+    printf("  -r <次数>   上传次数 (默认10)\n");
+    printf("  -S <种子>   随机数种子 (默认1)\n");
+    printf("  -c          压缩上传 (A2_FLAG_COMPRESSED)\n");
+    printf("  -C          模拟不支持压缩的旧固件 (拒绝压缩的A2)\n");
+    printf("  -d          差分上传 (A2_FLAG_DELTA)，每次上传前修改1字节\n");
+    printf("  -D          模拟不支持差分的旧固件 (拒绝差分的A2)\n");
+    printf("  -v          输出发送过程日志\n");
+}
+
+int main(int argc, char* argv[]) {
+    ble_sim_config_t config = {
+        .latency_ms = 20,
+        .jitter_ms = 5,
+        .write_rtt_ms = 15,
+        .ack_loss = 0,
+        .nak_rate = 0,
+        .mtu = 247,
+        .ack_packet_num = true,
+        .compression = true,
+        .delta = true,
+        .seed = 1,
+    };
+    a3_transport_t transport = A3_TRANSPORT_WRITE_CMD;
+    int window_size = A3_WINDOW_SIZE;
+    size_t payload_len = 4096;
+    int rounds = 10;
+    bool verbose = false;
+    bool compress = false;
+    bool delta = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:j:R:a:n:Am:w:t:s:r:S:cCdDvh")) != -1) {
+        switch (opt) {
+        case 'l': config.latency_ms = atoi(optarg); break;
+        case 'j': config.jitter_ms = atoi(optarg); break;
+        case 'R': config.write_rtt_ms = atoi(optarg); break;
+        case 'a': config.ack_loss = atof(optarg); break;
+        case 'n': config.nak_rate = atof(optarg); break;
+        case 'A': config.ack_packet_num = false; break;
+        case 'm': config.mtu = atoi(optarg); break;
+        case 'w': window_size = atoi(optarg); break;
+        case 's': payload_len = strtoul(optarg, NULL, 0); break;
+        case 'r': rounds = atoi(optarg); break;
+        case 'S': config.seed = strtoul(optarg, NULL, 0); break;
+        case 'c': compress = true; break;
+        case 'C': config.compression = false; break;
+        case 'd': delta = true; break;
+        case 'D': config.delta = false; break;
+        case 'v': verbose = true; break;
+        case 't':
+            if (strcmp(optarg, "req") == 0) {
+                transport = A3_TRANSPORT_WRITE_REQ;
+            } else if (strcmp(optarg, "cmd") == 0) {
+                transport = A3_TRANSPORT_WRITE_CMD;
+            } else if (strcmp(optarg, "stream") == 0) {
+                transport = A3_TRANSPORT_STREAM;
+            } else {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (payload_len == 0 || payload_len > UINT16_MAX || window_size < 1 || window_size > A3_WINDOW_MAX) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // 发送过程日志写到stdout，默认丢弃，结果写到stderr
+    if (!verbose && freopen("/dev/null", "w", stdout) == NULL) {
+        return 1;
+    }
+    if (verbose && ble_trace_start(stdout) != 0) {
+        return 1;
+    }
+
+    uint8_t* payload = malloc(payload_len);
+    uint8_t* payload_check = malloc(payload_len);
+    ble_session_t* session = malloc(sizeof(ble_session_t));
+    ble_sim_t* sim = ble_sim_create(&config);
+    if (payload == NULL || payload_check == NULL || session == NULL || sim == NULL) {
+        fprintf(stderr, "初始化失败\n");
+        return 1;
+    }
+    for (size_t i = 0; i < payload_len; i++) {
+        payload[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    ble_session_init(session, "sim");
+    session->a3_transport = transport;
+    session->window_size = (uint8_t)window_size;
+    session->compress = compress;
+    session->delta = delta;
+    ble_sim_attach(sim, session);
+
+    session->mtu = query_connection_mtu(session);
+    session->segment_size = (transport == A3_TRANSPORT_WRITE_REQ) ?
+                            a3_segment_size(session->mtu) : a3_pdu_segment_size(session->mtu);
+    if (!compress && a3_packet_count(payload_len, session->segment_size) == 0) {
+        fprintf(stderr, "数据过长: %zu字节需要超过255个A3包，减小-s或增大-m\n", payload_len);
+        return 2;
+    }
+
+    ble_cmd_a2_t a2_data = {
+        .cmd = CMD_A2,
+        .char_len = 1,
+    };
+
+    if (ble_session_start_dispatcher(session) != 0) {
+        fprintf(stderr, "创建发送线程失败\n");
+        return 1;
+    }
+    double start = now_sec();
+    for (int i = 0; i < rounds; i++) {
+        // 模拟小范围修改，上一次上传已完成，可以直接改数据
+        if (delta && i > 0) {
+            payload[(size_t)i * 997 % payload_len] ^= 0x55;
+        }
+        ble_session_queue_upload(session, &a2_data, payload, payload_len);
+        ble_session_flush(session);
+    }
+    double elapsed = now_sec() - start;
+    ble_session_stop_dispatcher(session);
+    ble_trace_stop();
+
+    ble_sim_stats_t stats;
+    ble_sim_get_stats(sim, &stats);
+
+    unsigned long payload_total = (unsigned long)payload_len * rounds;
+    fprintf(stderr, "发送方式=%d 窗口=%d MTU=%u 数据段=%zu 延迟=%ums±%ums 丢失率=%.3f 失败率=%.3f\n",
+            transport, window_size, session->mtu, session->segment_size,
+            config.latency_ms, config.jitter_ms, config.ack_loss, config.nak_rate);
+    fprintf(stderr, "上传 %d 次，共 %lu 字节，用时 %.3f 秒，吞吐 %.1f 字节/秒\n",
+            rounds, payload_total, elapsed, payload_total / elapsed);
+    fprintf(stderr, "设备: 帧 %lu，错误帧 %lu，成功反馈 %lu，失败反馈 %lu，丢失反馈 %lu，"
+            "A3数据 %lu 字节 (重发开销 %.1f%%)，完整上传 %lu\n",
+            stats.frames, stats.bad_frames, stats.acks, stats.naks, stats.lost_acks,
+            stats.a3_bytes, stats.upload_bytes ? 100.0 * (stats.a3_bytes - (double)stats.upload_bytes) / stats.upload_bytes : 0.0,
+            stats.uploads);
+    if (compress || delta) {
+        fprintf(stderr, "编码: 压缩上传 %lu 次，差分上传 %lu 次，拒绝A2 %lu 次，A3数据 %lu 字节，"
+                "设备还原 %lu 字节 (%.1f%%)\n",
+                stats.compressed_uploads, stats.delta_uploads, stats.rejected_a2, stats.upload_bytes,
+                stats.payload_bytes, stats.payload_bytes ? 100.0 * stats.upload_bytes / stats.payload_bytes : 0.0);
+    }
+    fprintf(stderr, "发送端: 成功 %d，失败 %d\n", session->success_count, session->fail_count);
+
+    // 设备拒绝带标志的A2时，每次拒绝重发MAX_RETRIES次后记一次失败，之后去掉标志重发
+    int expected_fail = (int)(stats.rejected_a2 / MAX_RETRIES);
+    bool content_ok = ble_sim_get_content(sim, payload_check, payload_len) == payload_len &&
+                      memcmp(payload_check, payload, payload_len) == 0;
+    if (!content_ok) {
+        fprintf(stderr, "设备数据与最后一次上传不一致\n");
+    }
+    int ret = (session->fail_count == expected_fail && content_ok &&
+               stats.uploads == (unsigned long)rounds &&
+               stats.payload_bytes == payload_total && stats.bad_frames == 0) ? 0 : 1;
+
+    ble_sim_destroy(sim);
+    ble_session_destroy(session);
+    free(session);
+    free(payload);
+    free(payload_check);
+    return ret;
+}
@@ -0,0 +1,233 @@
+#include <string.h>
+#include <time.h>
+#include "ble_stats.h"
+
+#define HIST_LINEAR (1u << BLE_HIST_SUB_BITS)          // 逐个计数的值的个数
+#define HIST_HALF (1u << (BLE_HIST_SUB_BITS - 1))      // 每个2的幂区间的子桶数
+
+int64_t ble_stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// 值所在的桶：最高位决定区间，接下来的BLE_HIST_SUB_BITS-1位决定子桶
+static size_t hist_index(uint64_t value) {
+    if (value < HIST_LINEAR) {
+        return (size_t)value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    if (msb >= BLE_HIST_MAX_BITS) {
+        return BLE_HIST_BUCKETS - 1;
+    }
+    int shift = msb - BLE_HIST_SUB_BITS + 1;
+    return HIST_LINEAR + (size_t)(shift - 1) * HIST_HALF + (size_t)((value >> shift) - HIST_HALF);
+}
+
+// 桶内的最大值
+static uint64_t hist_upper(size_t index) {
+    if (index < HIST_LINEAR) {
+        return index;
+    }
+    size_t offset = index - HIST_LINEAR;
+    int shift = (int)(offset / HIST_HALF) + 1;
+    uint64_t sub = offset % HIST_HALF + HIST_HALF;
+    return ((sub + 1) << shift) - 1;
+}
+
+void ble_hist_init(ble_hist_t* hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+void ble_hist_record(ble_hist_t* hist, uint64_t value) {
+    hist->counts[hist_index(value)]++;
+    if (hist->total == 0 || value < hist->min) {
+        hist->min = value;
+    }
+    if (value > hist->max) {
+        hist->max = value;
+    }
+    hist->total++;
+    hist->sum += (double)value;
+}
+
+uint64_t ble_hist_percentile(const ble_hist_t* hist, double p) {
+    if (hist->total == 0) {
+        return 0;
+    }
+    if (p >= 100) {
+        return hist->max;
+    }
+    // 第p百分位是排序后的第ceil(p%*n)个样本 (至少第1个)
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)hist->total + 0.999999);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BLE_HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            uint64_t upper = hist_upper(i);
+            return (upper < hist->max) ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+double ble_hist_mean(const ble_hist_t* hist) {
+    return (hist->total > 0) ? hist->sum / (double)hist->total : 0;
+}
+
+static void rate_init(ble_rate_window_t* rate, int64_t window_ns) {
+    memset(rate, 0, sizeof(*rate));
+    rate->slot_ns = ((window_ns > 0) ? window_ns : BLE_RATE_WINDOW_NS) / BLE_RATE_SLOTS;
+}
+
+// 推进到now所在的槽，每结束一个槽统计一次最近一个窗口
+static void rate_advance(ble_rate_window_t* rate, int64_t now_ns) {
+    if (rate->slot_start_ns == 0) {
+        rate->slot_start_ns = now_ns;
+        return;
+    }
+    while (now_ns - rate->slot_start_ns >= rate->slot_ns) {
+        if (rate->filled < BLE_RATE_SLOTS) {
+            rate->filled++;
+        }
+        if (rate->filled == BLE_RATE_SLOTS) {
+            uint64_t bytes = 0;
+            for (int i = 0; i < BLE_RATE_SLOTS; i++) {
+                bytes += rate->slot_bytes[i];
+            }
+            double bps = (double)bytes * 1e9 / (double)(rate->slot_ns * BLE_RATE_SLOTS);
+            if (rate->windows == 0 || bps < rate->min_bps) {
+                rate->min_bps = bps;
+            }
+            if (bps > rate->max_bps) {
+                rate->max_bps = bps;
+            }
+            rate->sum_bps += bps;
+            rate->windows++;
+        }
+        rate->current = (rate->current + 1) % BLE_RATE_SLOTS;
+        rate->slot_bytes[rate->current] = 0;
+        rate->slot_start_ns += rate->slot_ns;
+    }
+}
+
+void ble_stats_init(ble_stats_t* stats, int64_t window_ns) {
+    memset(stats, 0, sizeof(*stats));
+    ble_hist_init(&stats->write_latency);
+    ble_hist_init(&stats->ack_rtt);
+    rate_init(&stats->rate, window_ns);
+}
+
+void ble_stats_record_write(ble_stats_t* stats, int64_t start_ns, int64_t end_ns,
+                            size_t bytes, int retries, bool ok) {
+    if (stats->writes == 0) {
+        stats->start_ns = start_ns;
+    }
+    stats->end_ns = end_ns;
+    stats->writes++;
+    stats->retries += (uint64_t)retries;
+    ble_hist_record(&stats->write_latency, (uint64_t)((end_ns - start_ns) / 1000));
+
+    rate_advance(&stats->rate, end_ns);
+    if (ok) {
+        stats->bytes += bytes;
+        stats->rate.slot_bytes[stats->rate.current] += bytes;
+    } else {
+        stats->failures++;
+    }
+}
+
+void ble_stats_record_ack(ble_stats_t* stats, int64_t rtt_us) {
+    stats->acks++;
+    if (rtt_us < 0) {
+        stats->ack_unmatched++;
+        return;
+    }
+    ble_hist_record(&stats->ack_rtt, (uint64_t)rtt_us);
+}
+
+static double elapsed_sec(const ble_stats_t* stats) {
+    return (stats->writes > 0) ? (double)(stats->end_ns - stats->start_ns) / 1e9 : 0;
+}
+
+static void print_hist(const char* name, const ble_hist_t* hist, FILE* fp) {
+    if (hist->total == 0) {
+        fprintf(fp, "%s: 无样本\n", name);
+        return;
+    }
+    fprintf(fp, "%s (us, %lu个样本): 最小 %lu  p50 %lu  p90 %lu  p99 %lu  最大 %lu  平均 %.1f\n",
+            name, (unsigned long)hist->total, (unsigned long)hist->min,
+            (unsigned long)ble_hist_percentile(hist, 50), (unsigned long)ble_hist_percentile(hist, 90),
+            (unsigned long)ble_hist_percentile(hist, 99), (unsigned long)hist->max, ble_hist_mean(hist));
+}
+
+void ble_stats_print(const ble_stats_t* stats, FILE* fp) {
+    double elapsed = elapsed_sec(stats);
+
+    fprintf(fp, "写入 %lu 次，失败 %lu 次，重试 %lu 次，成功 %lu 字节，用时 %.3f 秒，平均 %.1f 字节/秒\n",
+            (unsigned long)stats->writes, (unsigned long)stats->failures, (unsigned long)stats->retries,
+            (unsigned long)stats->bytes, elapsed, (elapsed > 0) ? (double)stats->bytes / elapsed : 0);
+    if (stats->rate.windows > 0) {
+        fprintf(fp, "%.1f秒滑动窗口吞吐量 (字节/秒): 最小 %.1f  平均 %.1f  最大 %.1f\n",
+                (double)(stats->rate.slot_ns * BLE_RATE_SLOTS) / 1e9, stats->rate.min_bps,
+                stats->rate.sum_bps / (double)stats->rate.windows, stats->rate.max_bps);
+    }
+    print_hist("写入延迟", &stats->write_latency, fp);
+    if (stats->acks > 0) {
+        print_hist("反馈RTT", &stats->ack_rtt, fp);
+        if (stats->ack_unmatched > 0) {
+            fprintf(fp, "没有对应写入的反馈: %lu\n", (unsigned long)stats->ack_unmatched);
+        }
+    }
+}
+
+static void json_string(const char* s, FILE* fp) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(fp, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void json_hist(const char* name, const ble_hist_t* hist, FILE* fp) {
+    fprintf(fp, "\"%s\":{\"count\":%lu,\"min\":%lu,\"mean\":%.1f,\"p50\":%lu,\"p90\":%lu,"
+                "\"p99\":%lu,\"p999\":%lu,\"max\":%lu}",
+            name, (unsigned long)hist->total, (unsigned long)hist->min, ble_hist_mean(hist),
+            (unsigned long)ble_hist_percentile(hist, 50), (unsigned long)ble_hist_percentile(hist, 90),
+            (unsigned long)ble_hist_percentile(hist, 99), (unsigned long)ble_hist_percentile(hist, 99.9),
+            (unsigned long)hist->max);
+}
+
+void ble_stats_write_json(const ble_stats_t* stats, const char* label, FILE* fp) {
+    double elapsed = elapsed_sec(stats);
+    const ble_rate_window_t* rate = &stats->rate;
+
+    fputc('{', fp);
+    if (label != NULL) {
+        fputs("\"label\":", fp);
+        json_string(label, fp);
+        fputc(',', fp);
+    }
+    fprintf(fp, "\"writes\":%lu,\"failures\":%lu,\"retries\":%lu,\"bytes\":%lu,\"elapsed_sec\":%.6f,"
+                "\"bytes_per_sec\":%.1f,",
+            (unsigned long)stats->writes, (unsigned long)stats->failures, (unsigned long)stats->retries,
+            (unsigned long)stats->bytes, elapsed, (elapsed > 0) ? (double)stats->bytes / elapsed : 0);
+    fprintf(fp, "\"window\":{\"sec\":%.3f,\"count\":%lu,\"min_bps\":%.1f,\"mean_bps\":%.1f,\"max_bps\":%.1f},",
+            (double)(rate->slot_ns * BLE_RATE_SLOTS) / 1e9, (unsigned long)rate->windows, rate->min_bps,
+            (rate->windows > 0) ? rate->sum_bps / (double)rate->windows : 0, rate->max_bps);
+    json_hist("write_latency_us", &stats->write_latency, fp);
+    fputc(',', fp);
+    json_hist("ack_rtt_us", &stats->ack_rtt, fp);
+    fprintf(fp, ",\"acks\":%lu,\"ack_unmatched\":%lu}\n",
+            (unsigned long)stats->acks, (unsigned long)stats->ack_unmatched);
+}
@@ -0,0 +1,87 @@
+#ifndef BLE_STATS_H
+
+#define BLE_STATS_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// 发送测量：写入延迟和反馈RTT的直方图、滑动窗口吞吐量、重试次数，
+// 结束时输出分位数，可选输出JSON，用于比较固件版本、适配器和连接参数
+
+// HDR风格直方图：小于2^BLE_HIST_SUB_BITS的值逐个计数，
+// 更大的值每个2的幂区间分2^(BLE_HIST_SUB_BITS-1)个子桶，相对误差不超过1/64
+// 记录范围0 ~ 2^BLE_HIST_MAX_BITS-1 (按微秒约12.7天)，超出的值计入最后一个桶
+#define BLE_HIST_SUB_BITS 7
+#define BLE_HIST_MAX_BITS 40
+#define BLE_HIST_BUCKETS ((1 << BLE_HIST_SUB_BITS) + \
+                          (BLE_HIST_MAX_BITS - BLE_HIST_SUB_BITS) * (1 << (BLE_HIST_SUB_BITS - 1)))
+
+typedef struct {
+    uint64_t counts[BLE_HIST_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} ble_hist_t;
+
+void ble_hist_init(ble_hist_t* hist);
+void ble_hist_record(ble_hist_t* hist, uint64_t value);
+
+// 第p百分位 (0~100)，返回所在桶的上界 (不超过最大值)；没有样本时返回0
+uint64_t ble_hist_percentile(const ble_hist_t* hist, double p);
+double ble_hist_mean(const ble_hist_t* hist);
+
+// 滑动窗口吞吐量：时间分成BLE_RATE_SLOTS个槽，每过一个槽统计一次最近一个窗口的字节/秒
+#define BLE_RATE_SLOTS 10
+#define BLE_RATE_WINDOW_NS 1000000000LL     // 默认窗口1秒 (每槽100ms)
+
+typedef struct {
+    int64_t slot_ns;                        // 槽长度
+    int64_t slot_start_ns;                  // 当前槽的开始时间，0表示还没有数据
+    uint64_t slot_bytes[BLE_RATE_SLOTS];
+    int current;                            // 当前槽
+    int filled;                             // 已结束的槽数 (满一个窗口后才统计)
+    uint64_t windows;                       // 统计过的窗口数
+    double min_bps;
+    double max_bps;
+    double sum_bps;
+} ble_rate_window_t;
+
+// 一次测试的全部统计，时间单位为微秒
+typedef struct {
+    ble_hist_t write_latency;       // 单次写入调用的耗时 (含重试)
+    ble_hist_t ack_rtt;             // 写入到设备反馈通知的时间
+    ble_rate_window_t rate;
+    uint64_t writes;                // 写入次数 (不含重试)
+    uint64_t failures;              // 重试后仍失败的次数
+    uint64_t retries;               // 重试次数
+    uint64_t bytes;                 // 成功写入的字节数
+    uint64_t acks;                  // 收到的反馈数
+    uint64_t ack_unmatched;         // 没有对应写入的反馈数
+    int64_t start_ns;               // 第一次写入开始的时间
+    int64_t end_ns;                 // 最后一次写入结束的时间
+} ble_stats_t;
+
+// CLOCK_MONOTONIC纳秒
+int64_t ble_stats_now_ns(void);
+
+// window_ns为吞吐量窗口长度，0表示BLE_RATE_WINDOW_NS
+void ble_stats_init(ble_stats_t* stats, int64_t window_ns);
+
+// 记录一次写入：start_ns/end_ns为写入调用前后的时间，retries为这次写入的重试次数
+void ble_stats_record_write(ble_stats_t* stats, int64_t start_ns, int64_t end_ns,
+                            size_t bytes, int retries, bool ok);
+
+// 记录一次反馈，rtt_us < 0 表示没有对应的写入
+void ble_stats_record_ack(ble_stats_t* stats, int64_t rtt_us);
+
+// 输出可读的报告
+void ble_stats_print(const ble_stats_t* stats, FILE* fp);
+
+// 输出一个JSON对象，label用于标记测试 (固件版本、适配器等)，可以为NULL
+void ble_stats_write_json(const ble_stats_t* stats, const char* label, FILE* fp);
+
+#endif  /* BLE_STATS_H */
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "ble_trace.h"
+
+#if BLE_TRACE_LEVEL > BLE_TRACE_LEVEL_OFF
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define BLE_TRACE_RING_MASK (BLE_TRACE_RING_SIZE - 1)
+#define BLE_TRACE_IDLE_NS 5000000   // 缓冲区为空时后台线程休眠5ms
+
+_Static_assert((BLE_TRACE_RING_SIZE & BLE_TRACE_RING_MASK) == 0, "BLE_TRACE_RING_SIZE必须是2的幂");
+
+// 环形缓冲区的一个槽位
+// seq == 位置：槽位空闲，可由该位置的写入者占用
+// seq == 位置+1：记录已写完，可由后台线程读取
+typedef struct {
+    _Atomic uint64_t seq;
+    uint64_t timestamp_ns;
+    uint32_t arg0;
+    uint32_t arg1;
+    uint16_t event;
+    uint8_t level;
+    uint8_t data_len;
+    char tag[BLE_TRACE_TAG_MAX];
+    uint8_t data[BLE_TRACE_DATA_MAX];
+} __attribute__((aligned(64))) ble_trace_slot_t;
+
+static struct {
+    ble_trace_slot_t slots[BLE_TRACE_RING_SIZE];
+    _Atomic uint64_t head;      // 下一个写入位置 (多个写入者)
+    uint64_t tail;              // 下一个读取位置 (只有后台线程使用)
+    _Atomic uint64_t dropped;   // 缓冲区满时丢弃的记录数
+    _Atomic bool enabled;
+    _Atomic bool stopping;
+    pthread_t thread;
+    FILE* out;
+} m_trace;
+
+static const char* const m_trace_format[BLE_TRACE_EVENT_COUNT] = {
+    [BLE_TRACE_NOTIFY]           = "收到通知: 长度=%u",
+    [BLE_TRACE_NOTIFY_OTHER]     = "收到非目标UUID的通知: 长度=%u",
+    [BLE_TRACE_FEEDBACK]         = "收到反馈: 0x%02X",
+    [BLE_TRACE_FEEDBACK_EMPTY]   = "收到无效反馈数据（空）",
+    [BLE_TRACE_WINDOW_ACK]       = "A3包 %u 已确认",
+    [BLE_TRACE_WINDOW_NAK]       = "A3包 %u 收到失败反馈 (0x%02X)",
+    [BLE_TRACE_WINDOW_UNMATCHED] = "收到无法匹配的窗口反馈: 0x%02X 包序号=%u",
+};
+
+static const char* const m_trace_level_name[] = { "", "E", "I", "D" };
+
+void ble_trace_emit(uint8_t level, ble_trace_event_t event, const char* tag,
+                    uint32_t arg0, uint32_t arg1, const void* data, size_t len) {
+    if (!atomic_load_explicit(&m_trace.enabled, memory_order_relaxed)) {
+        return;
+    }
+
+    // 占用一个槽位：槽位的seq等于当前写入位置时才能占用
+    ble_trace_slot_t* slot;
+    uint64_t pos = atomic_load_explicit(&m_trace.head, memory_order_relaxed);
+    for (;;) {
+        slot = &m_trace.slots[pos & BLE_TRACE_RING_MASK];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&m_trace.head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // 后台线程还没读走上一轮的记录
+            atomic_fetch_add_explicit(&m_trace.dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&m_trace.head, memory_order_relaxed);
+        }
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    slot->timestamp_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    slot->arg0 = arg0;
+    slot->arg1 = arg1;
+    slot->event = (uint16_t)event;
+    slot->level = level;
+    if (tag) {
+        strncpy(slot->tag, tag, BLE_TRACE_TAG_MAX - 1);
+        slot->tag[BLE_TRACE_TAG_MAX - 1] = '\0';
+    } else {
+        slot->tag[0] = '\0';
+    }
+    if (len > BLE_TRACE_DATA_MAX) {
+        len = BLE_TRACE_DATA_MAX;
+    }
+    if (len > 0) {
+        memcpy(slot->data, data, len);
+    }
+    slot->data_len = (uint8_t)len;
+
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+static void trace_print(const ble_trace_slot_t* slot) {
+    FILE* out = m_trace.out;
+
+    fprintf(out, "[%llu.%06llu] %s [%s] ",
+            (unsigned long long)(slot->timestamp_ns / 1000000000ULL),
+            (unsigned long long)(slot->timestamp_ns % 1000000000ULL / 1000),
+            m_trace_level_name[slot->level], slot->tag);
+    if (slot->event < BLE_TRACE_EVENT_COUNT) {
+        fprintf(out, m_trace_format[slot->event], slot->arg0, slot->arg1);
+    } else {
+        fprintf(out, "未知事件 %u", slot->event);
+    }
+    if (slot->data_len > 0) {
+        fprintf(out, " 数据:");
+        for (int i = 0; i < slot->data_len; i++) {
+            fprintf(out, " %02X", slot->data[i]);
+        }
+    }
+    fputc('\n', out);
+}
+
+// 读出所有已写完的记录，返回读出条数
+static int trace_drain(void) {
+    int count = 0;
+
+    for (;;) {
+        ble_trace_slot_t* slot = &m_trace.slots[m_trace.tail & BLE_TRACE_RING_MASK];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq != m_trace.tail + 1) {
+            break;
+        }
+        trace_print(slot);
+        // 槽位留给下一轮同一位置的写入者
+        atomic_store_explicit(&slot->seq, m_trace.tail + BLE_TRACE_RING_SIZE, memory_order_release);
+        m_trace.tail++;
+        count++;
+    }
+
+    uint64_t dropped = atomic_exchange_explicit(&m_trace.dropped, 0, memory_order_relaxed);
+    if (dropped > 0) {
+        fprintf(m_trace.out, "跟踪缓冲区已满，丢弃 %llu 条记录\n", (unsigned long long)dropped);
+    }
+    if (count > 0 || dropped > 0) {
+        fflush(m_trace.out);
+    }
+    return count;
+}
+
+static void* trace_thread(void* arg) {
+    const struct timespec idle = { 0, BLE_TRACE_IDLE_NS };
+
+    while (!atomic_load_explicit(&m_trace.stopping, memory_order_acquire)) {
+        if (trace_drain() == 0) {
+            nanosleep(&idle, NULL);
+        }
+    }
+    trace_drain();
+    return NULL;
+}
+
+int ble_trace_start(FILE* out) {
+    if (atomic_load(&m_trace.enabled)) {
+        return 0;
+    }
+
+    for (uint64_t i = 0; i < BLE_TRACE_RING_SIZE; i++) {
+        atomic_init(&m_trace.slots[i].seq, i);
+    }
+    atomic_store(&m_trace.head, 0);
+    m_trace.tail = 0;
+    atomic_store(&m_trace.dropped, 0);
+    atomic_store(&m_trace.stopping, false);
+    m_trace.out = out ? out : stdout;
+
+    if (pthread_create(&m_trace.thread, NULL, trace_thread, NULL) != 0) {
+        return -1;
+    }
+    atomic_store(&m_trace.enabled, true);
+    return 0;
+}
+
+void ble_trace_stop(void) {
+    if (!atomic_exchange(&m_trace.enabled, false)) {
+        return;
+    }
+    atomic_store_explicit(&m_trace.stopping, true, memory_order_release);
+    pthread_join(m_trace.thread, NULL);
+}
+
+#else /* BLE_TRACE_LEVEL == BLE_TRACE_LEVEL_OFF */
+
+int ble_trace_start(FILE* out) {
+    return 0;
+}
+
+void ble_trace_stop(void) {
+}
+
+void ble_trace_emit(uint8_t level, ble_trace_event_t event, const char* tag,
+                    uint32_t arg0, uint32_t arg1, const void* data, size_t len) {
+}
+
+#endif /* BLE_TRACE_LEVEL */
@@ -0,0 +1,72 @@
+#ifndef BLE_TRACE_H
+
+#define BLE_TRACE_H
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// 热路径跟踪：调用方只写二进制记录到无锁环形缓冲区，后台线程负责格式化输出
+// 跟踪级别在编译时确定，高于BLE_TRACE_LEVEL的跟踪点连同参数求值一起被去掉
+// 例: gcc -DBLE_TRACE_LEVEL=3 ... 打开调试跟踪；-DNDEBUG 默认关闭全部跟踪
+
+#define BLE_TRACE_LEVEL_OFF   0
+#define BLE_TRACE_LEVEL_ERROR 1
+#define BLE_TRACE_LEVEL_INFO  2
+#define BLE_TRACE_LEVEL_DEBUG 3
+
+#ifndef BLE_TRACE_LEVEL
+#ifdef NDEBUG
+#define BLE_TRACE_LEVEL BLE_TRACE_LEVEL_OFF
+#else
+#define BLE_TRACE_LEVEL BLE_TRACE_LEVEL_INFO
+#endif
+#endif
+
+#define BLE_TRACE_RING_SIZE 1024  // 环形缓冲区记录数(2的幂)
+#define BLE_TRACE_DATA_MAX  20    // 每条记录保存的数据字节数，超出部分截断
+#define BLE_TRACE_TAG_MAX   18    // 记录来源标签长度(MAC地址)
+
+// 跟踪事件，格式字符串在ble_trace.c中，只在后台线程使用
+typedef enum {
+    BLE_TRACE_NOTIFY,           // 收到通知 arg0=长度，data=内容
+    BLE_TRACE_NOTIFY_OTHER,     // 收到非目标UUID的通知 arg0=长度
+    BLE_TRACE_FEEDBACK,         // 收到反馈 arg0=反馈码
+    BLE_TRACE_FEEDBACK_EMPTY,   // 收到空反馈
+    BLE_TRACE_WINDOW_ACK,       // A3包确认 arg0=包序号
+    BLE_TRACE_WINDOW_NAK,       // A3包失败反馈 arg0=包序号，arg1=反馈码
+    BLE_TRACE_WINDOW_UNMATCHED, // 窗口反馈无法匹配在途包 arg0=反馈码，arg1=包序号(0表示不带)
+    BLE_TRACE_EVENT_COUNT
+} ble_trace_event_t;
+
+// 启动后台输出线程，之前的跟踪点直接丢弃；成功返回0
+int ble_trace_start(FILE* out);
+// 输出缓冲区中剩余的记录并停止后台线程
+void ble_trace_stop(void);
+// 写入一条记录，缓冲区满时丢弃并计数；不要直接调用，使用下面的宏
+void ble_trace_emit(uint8_t level, ble_trace_event_t event, const char* tag,
+                    uint32_t arg0, uint32_t arg1, const void* data, size_t len);
+
+#if BLE_TRACE_LEVEL >= BLE_TRACE_LEVEL_ERROR
+#define BLE_TRACE_ERROR(event, tag, arg0, arg1, data, len) \
+    ble_trace_emit(BLE_TRACE_LEVEL_ERROR, event, tag, arg0, arg1, data, len)
+#else
+#define BLE_TRACE_ERROR(event, tag, arg0, arg1, data, len) ((void)0)
+#endif
+
+#if BLE_TRACE_LEVEL >= BLE_TRACE_LEVEL_INFO
+#define BLE_TRACE_INFO(event, tag, arg0, arg1, data, len) \
+    ble_trace_emit(BLE_TRACE_LEVEL_INFO, event, tag, arg0, arg1, data, len)
+#else
+#define BLE_TRACE_INFO(event, tag, arg0, arg1, data, len) ((void)0)
+#endif
+
+#if BLE_TRACE_LEVEL >= BLE_TRACE_LEVEL_DEBUG
+#define BLE_TRACE_DEBUG(event, tag, arg0, arg1, data, len) \
+    ble_trace_emit(BLE_TRACE_LEVEL_DEBUG, event, tag, arg0, arg1, data, len)
+#else
+#define BLE_TRACE_DEBUG(event, tag, arg0, arg1, data, len) ((void)0)
+#endif
+
+#endif  /* BLE_TRACE_H */
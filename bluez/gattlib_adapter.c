@@ -262,6 +262,14 @@ int gattlib_adapter_scan_disable(gattlib_adapter_t* adapter) {
 	return result;
 }
 
+int gattlib_adapter_register_known_device(gattlib_adapter_t* adapter, const char *mac_address) {
+	// The legacy backend connects to the Bluetooth address directly, no discovery is needed
+	if (mac_address == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	return GATTLIB_SUCCESS;
+}
+
 int gattlib_adapter_close(gattlib_adapter_t* adapter) {
 	hci_close_dev(*(int*)adapter);
 	free(adapter);
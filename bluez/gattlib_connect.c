@@ -569,6 +569,14 @@ int get_handle_from_uuid(gattlib_connection_t* connection, const uuid_t* uuid, u
 	return GATTLIB_NOT_FOUND;
 }
 
+int gattlib_get_handle_from_uuid(gattlib_connection_t* connection, const uuid_t* uuid, uint16_t* handle) {
+	if ((connection == NULL) || (uuid == NULL) || (handle == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	// Characteristics are discovered once on connection
+	return get_handle_from_uuid(connection, uuid, handle);
+}
+
 #if 0 // Disable until https://github.com/labapart/gattlib/issues/75 is resolved
 int gattlib_get_rssi(gattlib_connection_t *connection, int16_t *rssi)
 {
@@ -225,6 +225,40 @@ int gattlib_notification_start(gattlib_connection_t* connection, const uuid_t* u
 	return gattlib_write_char_by_handle(connection, handle + 1, &enable_notification, sizeof(enable_notification));
 }
 
+int gattlib_notification_start_with_handler(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_event_handler_t notification_handler, void* user_data)
+{
+	// Only supported in the DBUS API (ie: Bluez > v5.40) at the moment
+	if (notification_handler != NULL) {
+		return GATTLIB_NOT_SUPPORTED;
+	}
+	return gattlib_notification_start(connection, uuid);
+}
+
+int gattlib_notification_start_acquired(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_event_handler_t notification_handler, void* user_data)
+{
+	// Notification socket is only available with the DBUS API (ie: Bluez >= v5.48)
+	return gattlib_notification_start_with_handler(connection, uuid, notification_handler, user_data);
+}
+
+int gattlib_notification_on_ready(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_notification_ready_handler_t ready_handler, void* user_data)
+{
+	if (ready_handler == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// gattlib_notification_start() only returns once the CCCD write has been acknowledged
+	ready_handler(connection, uuid, user_data);
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_notification_wait_ready(gattlib_connection_t* connection, const uuid_t* uuid, unsigned int timeout_ms) {
+	// gattlib_notification_start() only returns once the CCCD write has been acknowledged
+	return GATTLIB_SUCCESS;
+}
+
 int gattlib_notification_stop(gattlib_connection_t* connection, const uuid_t* uuid) {
 	uint16_t handle;
 	uint16_t enable_notification = 0x0000;
@@ -0,0 +1,88 @@
+// 校验和实现对比与性能测试
+// 编译: gcc -O2 -o checksum_bench checksum_bench.c ble_checksum.c -lpthread
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ble_checksum.h"
+
+#define MAX_LEN 65536
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 校验所有实现的结果一致，包括不同对齐、不同长度和增量切分
+static int verify(const uint8_t* buffer) {
+    for (size_t offset = 0; offset < 32; offset++) {
+        for (size_t len = 0; len <= 1024; len++) {
+            uint16_t expected = ble_checksum_scalar(buffer + offset, len);
+            if (ble_checksum(buffer + offset, len) != expected) {
+                fprintf(stderr, "结果不一致: offset=%zu len=%zu\n", offset, len);
+                return 1;
+            }
+
+            ble_checksum_ctx_t ctx;
+            size_t pos = 0;
+            ble_checksum_init(&ctx);
+            while (pos < len) {
+                size_t chunk = (size_t)(rand() % 100) + 1;
+                if (chunk > len - pos) chunk = len - pos;
+                ble_checksum_update(&ctx, buffer + offset + pos, chunk);
+                pos += chunk;
+            }
+            if (ble_checksum_final(&ctx) != expected) {
+                fprintf(stderr, "增量结果不一致: offset=%zu len=%zu\n", offset, len);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void bench(const char* name, uint16_t (*fn)(const uint8_t*, size_t),
+                  const uint8_t* buffer, size_t len) {
+    // 每种长度处理约256MB数据
+    size_t iterations = (256u << 20) / (len ? len : 1);
+    volatile uint16_t sink = 0;
+
+    double start = now_sec();
+    for (size_t i = 0; i < iterations; i++) {
+        sink += fn(buffer, len);
+    }
+    double elapsed = now_sec() - start;
+
+    printf("  %-8s len=%-6zu %8.1f ns/次 %8.2f GB/s\n", name, len,
+           elapsed * 1e9 / iterations, (double)len * iterations / elapsed / 1e9);
+    (void)sink;
+}
+
+int main(void) {
+    static const size_t sizes[] = {4, 8, 23, 69, 260, 4096, MAX_LEN};
+    uint8_t* buffer = malloc(MAX_LEN + 64);
+    if (buffer == NULL) {
+        return 1;
+    }
+
+    srand(1);
+    for (size_t i = 0; i < MAX_LEN + 64; i++) {
+        buffer[i] = (uint8_t)rand();
+    }
+
+    printf("当前校验和实现: %s\n", ble_checksum_impl_name());
+    if (verify(buffer) != 0) {
+        free(buffer);
+        return 1;
+    }
+    printf("正确性校验通过\n");
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench("scalar", ble_checksum_scalar, buffer, sizes[i]);
+        bench(ble_checksum_impl_name(), ble_checksum, buffer, sizes[i]);
+    }
+
+    free(buffer);
+    return 0;
+}
@@ -45,70 +45,214 @@ void gattlib_notification_device_python_callback(const uuid_t* uuid, const uint8
 }
 #endif
 
-struct gattlib_notification_device_thread_args {
+/*
+ * Notification records are taken from a per-connection pool instead of being allocated for each
+ * notification. The pool grows by slabs of GATTLIB_NOTIFICATION_POOL_SLAB records when it runs
+ * out of free records and never shrinks, so a steady stream of notifications does not call
+ * malloc/free at all. Payloads up to GATTLIB_NOTIFICATION_INLINE_DATA bytes (the largest ATT
+ * attribute value) are copied into the record itself.
+ */
+struct gattlib_notification_record {
+	struct gattlib_notification_record* next; // Next free record
+	struct gattlib_notification_pool* pool;
 	gattlib_connection_t* connection;
-	uuid_t* uuid;
-	uint8_t* data;
+	uuid_t uuid;
+	// Handler of the characteristic. NULL to use the connection handler.
+	gattlib_event_handler_t handler;
+	void* user_data;
+	uint8_t* data; // Points to 'inline_data' unless the payload is larger
 	size_t data_length;
+	uint8_t inline_data[GATTLIB_NOTIFICATION_INLINE_DATA];
+};
+
+struct gattlib_notification_pool {
+	GMutex mutex;
+	struct gattlib_notification_record* free_records;
+	GSList* slabs;
+	// Records currently queued or being dispatched
+	size_t in_use;
+	// The connection has been freed. The last record to be released frees the pool.
+	bool closing;
 };
 
+struct gattlib_notification_pool* gattlib_notification_pool_new(void) {
+	struct gattlib_notification_pool* pool = calloc(sizeof(struct gattlib_notification_pool), 1);
+	if (pool == NULL) {
+		return NULL;
+	}
+	g_mutex_init(&pool->mutex);
+	return pool;
+}
+
+static void _notification_pool_destroy(struct gattlib_notification_pool* pool) {
+	g_slist_free_full(pool->slabs, free);
+	g_mutex_clear(&pool->mutex);
+	free(pool);
+}
+
+void gattlib_notification_pool_release(struct gattlib_notification_pool* pool) {
+	if (pool == NULL) {
+		return;
+	}
+
+	g_mutex_lock(&pool->mutex);
+	bool destroy = (pool->in_use == 0);
+	pool->closing = true;
+	g_mutex_unlock(&pool->mutex);
+
+	if (destroy) {
+		_notification_pool_destroy(pool);
+	}
+}
+
+static struct gattlib_notification_record* _notification_record_get(struct gattlib_notification_pool* pool) {
+	struct gattlib_notification_record* record;
+
+	g_mutex_lock(&pool->mutex);
+
+	if (pool->free_records == NULL) {
+		struct gattlib_notification_record* slab = malloc(sizeof(struct gattlib_notification_record) * GATTLIB_NOTIFICATION_POOL_SLAB);
+		if (slab == NULL) {
+			g_mutex_unlock(&pool->mutex);
+			return NULL;
+		}
+		pool->slabs = g_slist_prepend(pool->slabs, slab);
+
+		for (size_t i = 0; i < GATTLIB_NOTIFICATION_POOL_SLAB; i++) {
+			slab[i].pool = pool;
+			slab[i].next = pool->free_records;
+			pool->free_records = &slab[i];
+		}
+	}
+
+	record = pool->free_records;
+	pool->free_records = record->next;
+	pool->in_use++;
+
+	g_mutex_unlock(&pool->mutex);
+	return record;
+}
+
+static void _notification_record_put(struct gattlib_notification_record* record) {
+	struct gattlib_notification_pool* pool = record->pool;
+
+	if (record->data != record->inline_data) {
+		free(record->data);
+	}
+	record->data = NULL;
+
+	g_mutex_lock(&pool->mutex);
+	record->next = pool->free_records;
+	pool->free_records = record;
+	pool->in_use--;
+	bool destroy = pool->closing && (pool->in_use == 0);
+	g_mutex_unlock(&pool->mutex);
+
+	if (destroy) {
+		_notification_pool_destroy(pool);
+	}
+}
+
 void gattlib_notification_device_thread(gpointer data, gpointer user_data) {
-	struct gattlib_notification_device_thread_args* args = data;
+	struct gattlib_notification_record* record = data;
 	struct gattlib_handler* handler = user_data;
+	gattlib_connection_t* connection = record->connection;
 
 	g_rec_mutex_lock(&m_gattlib_mutex);
 
-	if (!gattlib_connection_is_connected(args->connection)) {
+	if (!gattlib_connection_is_connected(connection)) {
 		g_rec_mutex_unlock(&m_gattlib_mutex);
+		_notification_record_put(record);
 		return;
 	}
 
-	handler->callback.notification_handler(
-		args->uuid, args->data, args->data_length,
-		handler->user_data
-	);
+	// Ensure we increment device reference counter to prevent the device/connection is freed during the execution
+	gattlib_device_ref(connection->device);
 
+	// The handler runs without the global mutex so a slow handler does not stall the other devices.
+	// The connection lock only serialises it with the (re)registration of the handler.
 	g_rec_mutex_unlock(&m_gattlib_mutex);
 
-	if (args->uuid != NULL) {
-		free(args->uuid);
-		args->uuid = NULL;
-	}
-	if (args->data != NULL) {
-		free(args->data);
-		args->data = NULL;
+	g_rec_mutex_lock(&connection->handler_mutex);
+	if (record->handler != NULL) {
+		record->handler(&record->uuid, record->data, record->data_length, record->user_data);
+	} else if (handler->callback.notification_handler != NULL) {
+		handler->callback.notification_handler(
+			&record->uuid, record->data, record->data_length,
+			handler->user_data
+		);
 	}
+	g_rec_mutex_unlock(&connection->handler_mutex);
+
+	_notification_record_put(record);
+	gattlib_device_unref(connection->device);
 }
 
-static void* _notification_device_thread_args_allocator(gattlib_connection_t* connection, const uuid_t* uuid, const uint8_t* data, size_t data_length) {
-	struct gattlib_notification_device_thread_args* thread_args = calloc(sizeof(struct gattlib_notification_device_thread_args), 1);
-	thread_args->connection = connection;
-	thread_args->uuid = calloc(sizeof(uuid_t), 1);
-	if (thread_args->uuid != NULL) {
-		memcpy(thread_args->uuid, uuid, sizeof(uuid_t));
+static struct gattlib_notification_record* _notification_record_alloc(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_event_handler_t handler, void* user_data, const uint8_t* data, size_t data_length) {
+	struct gattlib_notification_record* record = _notification_record_get(connection->notification_pool);
+	if (record == NULL) {
+		return NULL;
 	}
-	thread_args->data = malloc(data_length);
-	if (thread_args->data != NULL) {
-		memcpy(thread_args->data, data, data_length);
+
+	if (data_length <= sizeof(record->inline_data)) {
+		record->data = record->inline_data;
+	} else {
+		record->data = malloc(data_length);
+		if (record->data == NULL) {
+			record->data = record->inline_data;
+			_notification_record_put(record);
+			return NULL;
+		}
 	}
-	thread_args->data_length = data_length;
 
-	return thread_args;
+	record->connection = connection;
+	memcpy(&record->uuid, uuid, sizeof(uuid_t));
+	record->handler = handler;
+	record->user_data = user_data;
+	memcpy(record->data, data, data_length);
+	record->data_length = data_length;
+
+	return record;
+}
+
+bool gattlib_has_notification_handler(gattlib_connection_t* connection) {
+	return gattlib_has_valid_handler(&connection->notification) ||
+		gattlib_notification_ring_has_batch_handler(connection);
 }
 
 void gattlib_on_gatt_notification(gattlib_connection_t* connection, const uuid_t* uuid, const uint8_t* data, size_t data_length) {
+	gattlib_on_gatt_notification_to_handler(connection, uuid, NULL, NULL, data, data_length);
+}
+
+void gattlib_on_gatt_notification_to_handler(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_event_handler_t handler, void* user_data, const uint8_t* data, size_t data_length) {
 	GError *error = NULL;
 
-	assert(connection->notification.thread_pool != NULL);
+	// The GLib mainloop and the AcquireNotify readers queue notifications concurrently
+	g_mutex_lock(&connection->producer_mutex);
 
-	void* arg = _notification_device_thread_args_allocator(connection, uuid, data, data_length);
-	if (arg == NULL) {
-		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_on_gatt_notification: Failed to allocate arguments for thread");
-		return;
+	if (gattlib_notification_ring_push(connection, uuid, handler, user_data, data, data_length)) {
+		goto EXIT;
 	}
-	g_thread_pool_push(connection->notification.thread_pool, arg, &error);
+
+	// The ring of a batch handler might have been stopped since the caller checked the handler
+	if ((connection->notification.thread_pool == NULL) || (connection->notification_pool == NULL)) {
+		goto EXIT;
+	}
+
+	struct gattlib_notification_record* record = _notification_record_alloc(connection, uuid, handler, user_data, data, data_length);
+	if (record == NULL) {
+		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_on_gatt_notification: Failed to allocate notification record");
+		goto EXIT;
+	}
+	g_thread_pool_push(connection->notification.thread_pool, record, &error);
 	if (error != NULL) {
 		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_on_gatt_notification: Failed to push thread in pool: %s", error->message);
 		g_error_free(error);
+		_notification_record_put(record);
 	}
+
+EXIT:
+	g_mutex_unlock(&connection->producer_mutex);
 }
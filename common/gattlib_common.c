@@ -10,16 +10,29 @@
 
 
 int gattlib_register_notification(gattlib_connection_t* connection, gattlib_event_handler_t notification_handler, void* user_data) {
-	GError *error = NULL;
 	int ret = GATTLIB_SUCCESS;
 
-	g_rec_mutex_lock(&m_gattlib_mutex);
-
 	if (connection == NULL) {
-		ret = GATTLIB_INVALID_PARAMETER;
-		goto EXIT;
+		return GATTLIB_INVALID_PARAMETER;
 	}
 
+	// 'handler_mutex' lives in the device: validate the connection and hold a device reference
+	// before touching it
+	g_rec_mutex_lock(&m_gattlib_mutex);
+	if (!gattlib_connection_is_valid(connection)) {
+		g_rec_mutex_unlock(&m_gattlib_mutex);
+		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_register_notification: Device not valid");
+		return GATTLIB_DEVICE_DISCONNECTED;
+	}
+	gattlib_device_t* device = connection->device;
+	gattlib_device_ref(device);
+	g_rec_mutex_unlock(&m_gattlib_mutex);
+
+	// Wait for a running handler to return before replacing it
+	g_rec_mutex_lock(&connection->handler_mutex);
+	g_rec_mutex_lock(&m_gattlib_mutex);
+
+	// The device might have been disconnected while we were waiting for the handler
 	if (!gattlib_connection_is_valid(connection)) {
 		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_register_notification: Device not valid");
 		ret = GATTLIB_DEVICE_DISCONNECTED;
@@ -29,35 +42,69 @@ int gattlib_register_notification(gattlib_connection_t* connection, gattlib_even
 	connection->notification.callback.notification_handler = notification_handler;
 	connection->notification.user_data = user_data;
 
+	ret = gattlib_notification_dispatch_init(connection);
+
+EXIT:
+	g_rec_mutex_unlock(&m_gattlib_mutex);
+	g_rec_mutex_unlock(&connection->handler_mutex);
+	gattlib_device_unref(device);
+	return ret;
+}
+
+int gattlib_notification_dispatch_init(gattlib_connection_t* connection) {
+	GError *error = NULL;
+
+	if (connection->notification_pool == NULL) {
+		connection->notification_pool = gattlib_notification_pool_new();
+		if (connection->notification_pool == NULL) {
+			return GATTLIB_OUT_OF_MEMORY;
+		}
+	}
+
+	if (connection->notification.thread_pool != NULL) {
+		return GATTLIB_SUCCESS;
+	}
+
 	connection->notification.thread_pool = g_thread_pool_new(
 		gattlib_notification_device_thread,
 		&connection->notification,
 		1 /* max_threads */, FALSE /* exclusive */, &error);
 	if (error != NULL) {
-		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_register_notification: Failed to create thread pool: %s", error->message);
+		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_notification_dispatch_init: Failed to create thread pool: %s", error->message);
 		g_error_free(error);
-		ret = GATTLIB_ERROR_INTERNAL;
-		goto EXIT;
+		return GATTLIB_ERROR_INTERNAL;
 	} else {
 		assert(connection->notification.thread_pool != NULL);
 	}
 
-EXIT:
-	g_rec_mutex_unlock(&m_gattlib_mutex);
-	return ret;
+	return GATTLIB_SUCCESS;
 }
 
 int gattlib_register_indication(gattlib_connection_t* connection, gattlib_event_handler_t indication_handler, void* user_data) {
 	GError *error = NULL;
 	int ret = GATTLIB_SUCCESS;
 
-	g_rec_mutex_lock(&m_gattlib_mutex);
-
 	if (connection == NULL) {
-		ret = GATTLIB_INVALID_PARAMETER;
-		goto EXIT;
+		return GATTLIB_INVALID_PARAMETER;
 	}
 
+	// 'handler_mutex' lives in the device: validate the connection and hold a device reference
+	// before touching it
+	g_rec_mutex_lock(&m_gattlib_mutex);
+	if (!gattlib_connection_is_valid(connection)) {
+		g_rec_mutex_unlock(&m_gattlib_mutex);
+		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_register_indication: Device not valid");
+		return GATTLIB_DEVICE_DISCONNECTED;
+	}
+	gattlib_device_t* device = connection->device;
+	gattlib_device_ref(device);
+	g_rec_mutex_unlock(&m_gattlib_mutex);
+
+	// Wait for a running handler to return before replacing it
+	g_rec_mutex_lock(&connection->handler_mutex);
+	g_rec_mutex_lock(&m_gattlib_mutex);
+
+	// The device might have been disconnected while we were waiting for the handler
 	if (!gattlib_connection_is_valid(connection)) {
 		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_register_indication: Device not valid");
 		ret = GATTLIB_DEVICE_DISCONNECTED;
@@ -67,6 +114,14 @@ int gattlib_register_indication(gattlib_connection_t* connection, gattlib_event_
 	connection->indication.callback.notification_handler = indication_handler;
 	connection->indication.user_data = user_data;
 
+	if (connection->notification_pool == NULL) {
+		connection->notification_pool = gattlib_notification_pool_new();
+		if (connection->notification_pool == NULL) {
+			ret = GATTLIB_OUT_OF_MEMORY;
+			goto EXIT;
+		}
+	}
+
 	connection->indication.thread_pool = g_thread_pool_new(
 		gattlib_notification_device_thread,
 		&connection->indication,
@@ -80,6 +135,8 @@ int gattlib_register_indication(gattlib_connection_t* connection, gattlib_event_
 
 EXIT:
 	g_rec_mutex_unlock(&m_gattlib_mutex);
+	g_rec_mutex_unlock(&connection->handler_mutex);
+	gattlib_device_unref(device);
 	return ret;
 }
 
@@ -75,6 +75,8 @@ int gattlib_device_set_state(gattlib_adapter_t* adapter, const char* device_id,
             device->device_id = g_strdup(device_id);
             device->state = new_state;
             device->connection.device = device;
+            g_rec_mutex_init(&device->connection.handler_mutex);
+            g_mutex_init(&device->connection.producer_mutex);
 
             adapter->devices = g_slist_append(adapter->devices, device);
         } else {
@@ -153,6 +155,10 @@ int gattlib_device_unref(gattlib_device_t* device) {
         goto EXIT;
     }
 
+    gattlib_notification_ring_stop(&device->connection);
+    gattlib_notification_pool_release(device->connection.notification_pool);
+    g_rec_mutex_clear(&device->connection.handler_mutex);
+    g_mutex_clear(&device->connection.producer_mutex);
     free(device);
 
 EXIT:
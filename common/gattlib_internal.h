@@ -26,6 +26,7 @@ struct gattlib_python_args {
 
 #define GATTLIB_SIGNAL_DEVICE_DISCONNECTION		(1 << 0)
 #define GATTLIB_SIGNAL_ADAPTER_STOP_SCANNING    (1 << 1)
+#define GATTLIB_SIGNAL_NOTIFICATION_READY       (1 << 2)
 
 struct gattlib_signal {
 	// Used by gattlib_disconnection when we want to wait for the disconnection to be effective
@@ -86,6 +87,16 @@ struct _gattlib_adapter {
 	struct gattlib_handler discovered_device_callback;
 };
 
+// Notification payloads up to this size are stored in the notification record itself
+#define GATTLIB_NOTIFICATION_INLINE_DATA	512
+// Number of notification records allocated at once when the pool is empty
+#define GATTLIB_NOTIFICATION_POOL_SLAB		16
+// Minimum number of notifications held by the ring of a batch handler
+#define GATTLIB_NOTIFICATION_BATCH_MIN_RING	256
+
+struct gattlib_notification_pool;
+struct gattlib_notification_ring;
+
 struct _gattlib_connection {
 	struct _gattlib_device* device;
 
@@ -93,9 +104,20 @@ struct _gattlib_connection {
 	struct _gattlib_connection_backend backend;
 
 	struct gattlib_handler on_connection;
+	// Held while the notification/indication handlers run and while they are registered. It must be
+	// taken before 'm_gattlib_mutex' when both are needed.
+	GRecMutex handler_mutex;
+	// Held while a notification is queued (ring or thread pool). The GLib mainloop and the
+	// AcquireNotify readers are the producers. It must be taken after 'm_gattlib_mutex'.
+	GMutex producer_mutex;
 	struct gattlib_handler notification;
 	struct gattlib_handler indication;
 	struct gattlib_handler on_disconnection;
+
+	// Pool of records used to pass notifications to the notification thread
+	struct gattlib_notification_pool* notification_pool;
+	// Set when notifications are dispatched through a SPSC ring (see gattlib_notification_enable_ring())
+	struct gattlib_notification_ring* notification_ring;
 };
 
 typedef struct _gattlib_device {
@@ -149,6 +171,52 @@ bool gattlib_has_valid_handler(struct gattlib_handler* handler);
 
 void gattlib_notification_device_thread(gpointer data, gpointer user_data);
 
+/**
+ * Check a handler receives the notifications of the connection
+ *
+ * Either the handler registered with gattlib_register_notification() or the batch handler of the ring.
+ */
+bool gattlib_has_notification_handler(gattlib_connection_t* connection);
+
+/**
+ * Create the notification record pool and the thread pool dispatching the notifications of the connection
+ *
+ * It must be called with 'm_gattlib_mutex' held. It does nothing if they already exist.
+ */
+int gattlib_notification_dispatch_init(gattlib_connection_t* connection);
+
+struct gattlib_notification_pool* gattlib_notification_pool_new(void);
+/**
+ * Release the notification pool of a freed connection
+ *
+ * Records still queued in the notification thread pool remain valid; the pool memory is freed
+ * when the last of them has been dispatched.
+ */
+void gattlib_notification_pool_release(struct gattlib_notification_pool* pool);
+
+/**
+ * Queue a notification in the connection ring
+ *
+ * Must be called with 'producer_mutex' of the connection held, so the ring has a single producer.
+ *
+ * @param handler Handler of the characteristic, NULL to use the connection handler or the batch handler
+ *
+ * @return false if the connection does not use a ring
+ */
+bool gattlib_notification_ring_push(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_event_handler_t handler, void* user_data, const uint8_t* data, size_t data_length);
+/**
+ * Check the notification ring of a connection dispatches to a batch handler
+ */
+bool gattlib_notification_ring_has_batch_handler(gattlib_connection_t* connection);
+/**
+ * Stop the notification ring of a connection
+ *
+ * Pending notifications are discarded. It does not wait for the consumer thread to exit, the consumer
+ * releases its device reference when it does.
+ */
+void gattlib_notification_ring_stop(gattlib_connection_t* connection);
+
 /**
  * Clean GATTLIB connection on disconnection
  *
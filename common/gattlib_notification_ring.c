@@ -0,0 +1,446 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024, Olivier Martin <olivier@labapart.org>
+ */
+
+// ppoll()
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "gattlib_internal.h"
+
+/*
+ * Single-producer/single-consumer notification ring
+ *
+ * The producer is the thread that receives notifications from the backend (the GLib mainloop or
+ * an AcquireNotify reader, serialised by the connection 'producer_mutex'), the consumer is a thread
+ * dedicated to the connection that calls the notification handler. Notifications are copied into
+ * the ring slots, so neither side allocates memory nor takes a lock of the ring. The consumer sleeps on an eventfd when the ring is empty; the producer only writes to
+ * the eventfd when the consumer has announced it is going to sleep.
+ *
+ * The consumer thread holds a reference on the device from the start of the ring until it exits, so
+ * the connection outlives any handler it calls without taking 'm_gattlib_mutex' per notification.
+ * The ring is stopped with 'm_gattlib_mutex' held when the connection is freed (disconnection). The
+ * consumer then discards the pending notifications, releases its device reference and exits.
+ * Stopping never waits for a notification handler to return (the handler might be waiting for
+ * 'm_gattlib_mutex'); a notification already being dispatched might complete after the ring is
+ * stopped. The ring is freed by whichever of the consumer and the stopping thread releases it last.
+ *
+ * With a batch handler (gattlib_register_notification_batch()) the consumer passes all the queued
+ * notifications to the handler at once, up to 'max_batch'. When fewer are queued it waits until
+ * the oldest one is 'max_latency_ns' old before dispatching a partial batch.
+ *
+ * Notifications of a characteristic with its own handler (gattlib_notification_start_with_handler())
+ * carry their handler in the slot. They are dispatched one by one, in order with the other
+ * notifications: a batch ends before such a notification.
+ */
+
+struct gattlib_notification_ring_slot {
+	uuid_t uuid;
+	// Handler of the characteristic. NULL to use the connection handler or the batch handler.
+	gattlib_event_handler_t handler;
+	void* user_data;
+	uint64_t timestamp_ns;
+	uint8_t* data; // Points to 'inline_data' unless the payload is larger
+	size_t data_length;
+	uint8_t inline_data[GATTLIB_NOTIFICATION_INLINE_DATA];
+};
+
+struct gattlib_notification_ring {
+	gattlib_connection_t* connection;
+	// Referenced by the consumer thread until it exits
+	gattlib_device_t* device;
+	struct gattlib_notification_ring_slot* slots;
+	size_t capacity; // Power of two
+	int eventfd;
+	GThread* thread;
+
+	// Batch dispatch, 'batch_handler' is NULL when notifications are dispatched one by one
+	gattlib_notification_batch_handler_t batch_handler;
+	void* batch_user_data;
+	size_t max_batch;
+	uint64_t max_latency_ns;
+	gattlib_notification_t* batch;
+
+	// Written by the producer only
+	size_t head __attribute__((aligned(64)));
+	size_t high_water;
+	uint64_t dropped;
+
+	// Written by the consumer only
+	size_t tail __attribute__((aligned(64)));
+	uint64_t dispatched;
+
+	// Set by the consumer before sleeping on the eventfd
+	int consumer_waiting __attribute__((aligned(64)));
+	int stopping;
+	// Held by the consumer thread and by the connection
+	int reference_counter;
+};
+
+static void _ring_free(struct gattlib_notification_ring* ring) {
+	for (size_t i = 0; i < ring->capacity; i++) {
+		if (ring->slots[i].data != ring->slots[i].inline_data) {
+			free(ring->slots[i].data);
+		}
+	}
+	if (ring->eventfd >= 0) {
+		close(ring->eventfd);
+	}
+	free(ring->batch);
+	free(ring->slots);
+	free(ring);
+}
+
+static void _ring_unref(struct gattlib_notification_ring* ring) {
+	if (__atomic_sub_fetch(&ring->reference_counter, 1, __ATOMIC_ACQ_REL) == 0) {
+		_ring_free(ring);
+	}
+}
+
+static void _ring_wait(struct gattlib_notification_ring* ring) {
+	uint64_t value;
+
+	while (read(ring->eventfd, &value, sizeof(value)) < 0 && errno == EINTR) {
+	}
+}
+
+static void _ring_wake(struct gattlib_notification_ring* ring) {
+	uint64_t value = 1;
+
+	while (write(ring->eventfd, &value, sizeof(value)) < 0 && errno == EINTR) {
+	}
+}
+
+static uint64_t _monotonic_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Sleep until the producer queues a notification beyond 'head' or the ring is stopped
+ *
+ * @param timeout_ns Maximum time to sleep, 0 to wait without timeout
+ */
+static void _ring_sleep(struct gattlib_notification_ring* ring, size_t head, uint64_t timeout_ns) {
+	// Announce we are going to sleep, then check again: either the producer sees the flag
+	// and writes to the eventfd, or we see its new record
+	__atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+	if ((__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == head) &&
+	    !__atomic_load_n(&ring->stopping, __ATOMIC_SEQ_CST)) {
+		if (timeout_ns == 0) {
+			_ring_wait(ring);
+		} else {
+			struct pollfd pfd = { .fd = ring->eventfd, .events = POLLIN };
+			struct timespec timeout = {
+				.tv_sec = timeout_ns / 1000000000ULL,
+				.tv_nsec = timeout_ns % 1000000000ULL,
+			};
+			if (ppoll(&pfd, 1, &timeout, NULL) > 0) {
+				_ring_wait(ring);
+			}
+		}
+	}
+	__atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+}
+
+static void _ring_release_slot(struct gattlib_notification_ring_slot* slot) {
+	if (slot->data != slot->inline_data) {
+		free(slot->data);
+		slot->data = slot->inline_data;
+	}
+}
+
+static void _ring_dispatch_one(struct gattlib_notification_ring* ring, size_t tail) {
+	struct gattlib_handler* handler = &ring->connection->notification;
+	struct gattlib_notification_ring_slot* slot = &ring->slots[tail & (ring->capacity - 1)];
+
+	// Serialised with gattlib_register_notification() so the handler and its user_data match
+	g_rec_mutex_lock(&ring->connection->handler_mutex);
+	if (slot->handler != NULL) {
+		slot->handler(&slot->uuid, slot->data, slot->data_length, slot->user_data);
+	} else if (handler->callback.notification_handler != NULL) {
+		handler->callback.notification_handler(&slot->uuid, slot->data, slot->data_length, handler->user_data);
+	}
+	g_rec_mutex_unlock(&ring->connection->handler_mutex);
+
+	_ring_release_slot(slot);
+	__atomic_store_n(&ring->dispatched, ring->dispatched + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void _ring_dispatch_batch(struct gattlib_notification_ring* ring, size_t tail, size_t count) {
+	size_t mask = ring->capacity - 1;
+
+	// The slots are only handed back to the producer once the handler has returned, so the batch
+	// can point to the data in the ring
+	for (size_t i = 0; i < count; i++) {
+		struct gattlib_notification_ring_slot* slot = &ring->slots[(tail + i) & mask];
+		ring->batch[i].uuid = &slot->uuid;
+		ring->batch[i].timestamp_ns = slot->timestamp_ns;
+		ring->batch[i].data = slot->data;
+		ring->batch[i].data_length = slot->data_length;
+	}
+
+	g_rec_mutex_lock(&ring->connection->handler_mutex);
+	ring->batch_handler(ring->connection, ring->batch, count, ring->batch_user_data);
+	g_rec_mutex_unlock(&ring->connection->handler_mutex);
+
+	for (size_t i = 0; i < count; i++) {
+		_ring_release_slot(&ring->slots[(tail + i) & mask]);
+	}
+	__atomic_store_n(&ring->dispatched, ring->dispatched + count, __ATOMIC_RELAXED);
+	__atomic_store_n(&ring->tail, tail + count, __ATOMIC_RELEASE);
+}
+
+static gpointer _ring_consumer_thread(gpointer data) {
+	struct gattlib_notification_ring* ring = data;
+
+	while (!__atomic_load_n(&ring->stopping, __ATOMIC_ACQUIRE)) {
+		size_t tail = ring->tail;
+		size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+		if (head == tail) {
+			_ring_sleep(ring, head, 0);
+			continue;
+		}
+
+		size_t mask = ring->capacity - 1;
+		if ((ring->batch_handler == NULL) || (ring->slots[tail & mask].handler != NULL)) {
+			_ring_dispatch_one(ring, tail);
+			continue;
+		}
+
+		size_t queued = head - tail;
+		size_t count = 0;
+		while ((count < queued) && (count < ring->max_batch) && (ring->slots[(tail + count) & mask].handler == NULL)) {
+			count++;
+		}
+
+		if ((count == queued) && (count < ring->max_batch)) {
+			// Wait for a full batch as long as the oldest notification is within the latency budget
+			uint64_t deadline = ring->slots[tail & mask].timestamp_ns + ring->max_latency_ns;
+			uint64_t now = _monotonic_ns();
+			if (now < deadline) {
+				_ring_sleep(ring, head, deadline - now);
+				continue;
+			}
+		}
+
+		_ring_dispatch_batch(ring, tail, count);
+	}
+
+	// The connection must not be accessed once the device reference is released
+	gattlib_device_t* device = ring->device;
+	_ring_unref(ring);
+	gattlib_device_unref(device);
+	return NULL;
+}
+
+static int _ring_start(gattlib_connection_t* connection, size_t capacity,
+		gattlib_notification_batch_handler_t batch_handler, void* batch_user_data,
+		size_t max_batch, uint64_t max_latency_ns) {
+	struct gattlib_notification_ring* ring = NULL;
+	GError *error = NULL;
+	int ret = GATTLIB_SUCCESS;
+
+	g_rec_mutex_lock(&m_gattlib_mutex);
+
+	if (!gattlib_connection_is_valid(connection)) {
+		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_notification_enable_ring: Device not valid");
+		ret = GATTLIB_DEVICE_DISCONNECTED;
+		goto EXIT;
+	}
+
+	if (connection->notification_ring != NULL) {
+		ret = GATTLIB_BUSY;
+		goto EXIT;
+	}
+
+	ring = calloc(sizeof(struct gattlib_notification_ring), 1);
+	if (ring == NULL) {
+		ret = GATTLIB_OUT_OF_MEMORY;
+		goto EXIT;
+	}
+	ring->connection = connection;
+	ring->eventfd = -1;
+	ring->reference_counter = 2;
+
+	ring->capacity = 1;
+	while (ring->capacity < capacity) {
+		ring->capacity <<= 1;
+	}
+
+	ring->slots = calloc(sizeof(struct gattlib_notification_ring_slot), ring->capacity);
+	if (ring->slots == NULL) {
+		ret = GATTLIB_OUT_OF_MEMORY;
+		goto EXIT;
+	}
+	for (size_t i = 0; i < ring->capacity; i++) {
+		ring->slots[i].data = ring->slots[i].inline_data;
+	}
+
+	if (batch_handler != NULL) {
+		ring->batch = calloc(sizeof(gattlib_notification_t), max_batch);
+		if (ring->batch == NULL) {
+			ret = GATTLIB_OUT_OF_MEMORY;
+			goto EXIT;
+		}
+		ring->batch_handler = batch_handler;
+		ring->batch_user_data = batch_user_data;
+		ring->max_batch = max_batch;
+		ring->max_latency_ns = max_latency_ns;
+	}
+
+	ring->eventfd = eventfd(0, EFD_CLOEXEC);
+	if (ring->eventfd < 0) {
+		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_notification_enable_ring: Failed to create eventfd: %s", strerror(errno));
+		ret = GATTLIB_ERROR_UNIX | errno;
+		goto EXIT;
+	}
+
+	// Released by the consumer thread when it exits
+	ring->device = connection->device;
+	gattlib_device_ref(ring->device);
+
+	ring->thread = g_thread_try_new("gattlib_notification_ring", _ring_consumer_thread, ring, &error);
+	if (ring->thread == NULL) {
+		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_notification_enable_ring: Failed to create thread: %s", error->message);
+		g_error_free(error);
+		gattlib_device_unref(ring->device);
+		ret = GATTLIB_ERROR_INTERNAL;
+		goto EXIT;
+	}
+
+	// Notifications are received on another thread that reads this pointer without the global mutex
+	__atomic_store_n(&connection->notification_ring, ring, __ATOMIC_RELEASE);
+	ring = NULL;
+
+EXIT:
+	if (ring != NULL) {
+		_ring_free(ring);
+	}
+	g_rec_mutex_unlock(&m_gattlib_mutex);
+	return ret;
+}
+
+int gattlib_notification_enable_ring(gattlib_connection_t* connection, size_t capacity) {
+	if ((connection == NULL) || (capacity == 0)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	return _ring_start(connection, capacity, NULL, NULL, 0, 0);
+}
+
+int gattlib_register_notification_batch(gattlib_connection_t* connection, gattlib_notification_batch_handler_t handler, void* user_data,
+		size_t max_batch, unsigned int max_latency_us) {
+	if ((connection == NULL) || (handler == NULL) || (max_batch == 0)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// Leave room for the producer to fill the next batch while the handler runs
+	size_t capacity = (max_batch * 4 > GATTLIB_NOTIFICATION_BATCH_MIN_RING) ? max_batch * 4 : GATTLIB_NOTIFICATION_BATCH_MIN_RING;
+
+	return _ring_start(connection, capacity, handler, user_data, max_batch, (uint64_t)max_latency_us * 1000);
+}
+
+bool gattlib_notification_ring_push(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_event_handler_t handler, void* user_data, const uint8_t* data, size_t data_length) {
+	struct gattlib_notification_ring* ring = __atomic_load_n(&connection->notification_ring, __ATOMIC_ACQUIRE);
+
+	if (ring == NULL) {
+		return false;
+	}
+
+	size_t head = ring->head;
+	size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if (head - tail == ring->capacity) {
+		__atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+		return true;
+	}
+
+	struct gattlib_notification_ring_slot* slot = &ring->slots[head & (ring->capacity - 1)];
+	if (data_length > sizeof(slot->inline_data)) {
+		slot->data = malloc(data_length);
+		if (slot->data == NULL) {
+			slot->data = slot->inline_data;
+			__atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+			return true;
+		}
+	}
+	memcpy(&slot->uuid, uuid, sizeof(uuid_t));
+	slot->handler = handler;
+	slot->user_data = user_data;
+	if (ring->batch_handler != NULL) {
+		slot->timestamp_ns = _monotonic_ns();
+	}
+	memcpy(slot->data, data, data_length);
+	slot->data_length = data_length;
+
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+	if (head + 1 - tail > ring->high_water) {
+		__atomic_store_n(&ring->high_water, head + 1 - tail, __ATOMIC_RELAXED);
+	}
+
+	if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_SEQ_CST)) {
+		_ring_wake(ring);
+	}
+	return true;
+}
+
+bool gattlib_notification_ring_has_batch_handler(gattlib_connection_t* connection) {
+	struct gattlib_notification_ring* ring = __atomic_load_n(&connection->notification_ring, __ATOMIC_ACQUIRE);
+
+	return (ring != NULL) && (ring->batch_handler != NULL);
+}
+
+void gattlib_notification_ring_stop(gattlib_connection_t* connection) {
+	struct gattlib_notification_ring* ring = connection->notification_ring;
+
+	if (ring == NULL) {
+		return;
+	}
+
+	// Wait for a producer still queuing in the ring
+	g_mutex_lock(&connection->producer_mutex);
+	__atomic_store_n(&connection->notification_ring, NULL, __ATOMIC_RELEASE);
+	g_mutex_unlock(&connection->producer_mutex);
+
+	__atomic_store_n(&ring->stopping, 1, __ATOMIC_SEQ_CST);
+	_ring_wake(ring);
+	g_thread_unref(ring->thread);
+	_ring_unref(ring);
+}
+
+int gattlib_notification_get_ring_stats(gattlib_connection_t* connection, gattlib_notification_ring_stats_t* stats) {
+	int ret = GATTLIB_SUCCESS;
+
+	if ((connection == NULL) || (stats == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	g_rec_mutex_lock(&m_gattlib_mutex);
+
+	struct gattlib_notification_ring* ring = connection->notification_ring;
+	if (!gattlib_connection_is_valid(connection) || (ring == NULL)) {
+		ret = GATTLIB_NOT_FOUND;
+		goto EXIT;
+	}
+
+	stats->capacity = ring->capacity;
+	stats->high_water = __atomic_load_n(&ring->high_water, __ATOMIC_RELAXED);
+	stats->dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+	stats->dispatched = __atomic_load_n(&ring->dispatched, __ATOMIC_RELAXED);
+
+EXIT:
+	g_rec_mutex_unlock(&m_gattlib_mutex);
+	return ret;
+}
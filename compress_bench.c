@@ -0,0 +1,195 @@
+// A3数据压缩的压缩率、A3包数和编解码速度测试，数据为点阵字模
+// 编译: gcc -O2 -o compress_bench compress_bench.c ble_compress.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ble_compress.h"
+
+#define SEGMENT_LEGACY 64       // 原固定长度A3数据段
+#define SEGMENT_MTU247 239      // MTU 247时无响应写入的A3数据段 (247 - 3 - 3 - 2)
+#define MAX_LEN 65535
+
+// 16x16汉字 (32字节) 和 8x16字符 (16字节)，与send_continuous_data()中的字模相同
+static const uint8_t m_glyph_cn[][32] = {
+    {
+        0x4 , 0x4 , 0xc4, 0xfc, 0x14, 0x2f, 0xa4, 0xa4,
+        0xa4, 0xa4, 0x2f, 0x24, 0xe4, 0x24, 0x24, 0x0 ,
+        0x2 , 0x1 , 0x0 , 0xff, 0x0 , 0x0 , 0x1f, 0x8 ,
+        0x8 , 0x1f, 0x40, 0x80, 0x7f, 0x0 , 0x0 , 0x0 ,
+    },
+    {
+        0x10, 0x10, 0xfe, 0x10, 0x10, 0xfc, 0x44, 0x54,
+        0x55, 0xfe, 0x54, 0x54, 0xf4, 0x44, 0x44, 0x0 ,
+        0x10, 0x10, 0xf , 0x48, 0x28, 0x1f, 0x0 , 0x7d,
+        0x25, 0x27, 0x25, 0x25, 0x7d, 0x0 , 0x0 , 0x0 ,
+    },
+    {
+        0x0 , 0x0 , 0x0 , 0x0 , 0x0 , 0xff, 0x11, 0x11,
+        0x11, 0x11, 0x11, 0xff, 0x0 , 0x0 , 0x0 , 0x0 ,
+        0x0 , 0x40, 0x20, 0x10, 0xc , 0x3 , 0x1 , 0x1 ,
+        0x1 , 0x21, 0x41, 0x3f, 0x0 , 0x0 , 0x0 , 0x0 ,
+    },
+};
+static const uint8_t m_glyph_en[][16] = {
+    {
+        0x0 , 0x0 , 0x0 , 0x80, 0x80, 0x88, 0xf8, 0x0 ,
+        0x0 , 0xe , 0x11, 0x20, 0x20, 0x10, 0x3f, 0x20,
+    },
+    {
+        0x80, 0x80, 0x80, 0x0 , 0x80, 0x80, 0x80, 0x0 ,
+        0x20, 0x20, 0x3f, 0x21, 0x20, 0x0 , 0x1 , 0x0 ,
+    },
+    {   // 空格
+        0x0 , 0x0 , 0x0 , 0x0 , 0x0 , 0x0 , 0x0 , 0x0 ,
+        0x0 , 0x0 , 0x0 , 0x0 , 0x0 , 0x0 , 0x0 , 0x0 ,
+    },
+};
+
+#define CN_COUNT (sizeof(m_glyph_cn) / sizeof(m_glyph_cn[0]))
+#define EN_COUNT (sizeof(m_glyph_en) / sizeof(m_glyph_en[0]))
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 随机排列字模，模拟一屏文字；cn_percent为汉字比例
+static size_t make_text(uint8_t* buffer, size_t chars, int cn_percent) {
+    size_t len = 0;
+    for (size_t i = 0; i < chars; i++) {
+        if (rand() % 100 < cn_percent) {
+            memcpy(buffer + len, m_glyph_cn[rand() % CN_COUNT], 32);
+            len += 32;
+        } else {
+            memcpy(buffer + len, m_glyph_en[rand() % EN_COUNT], 16);
+            len += 16;
+        }
+    }
+    return len;
+}
+
+static unsigned int packets(size_t len, size_t segment) {
+    return (unsigned int)((len + segment - 1) / segment);
+}
+
+// 压缩、解压并核对结果，输出压缩率、A3包数和速度
+static int bench(const char* name, const uint8_t* data, size_t len) {
+    static uint8_t packed[BLE_COMPRESS_BOUND(MAX_LEN)];
+    static uint8_t unpacked[MAX_LEN];
+
+    size_t packed_len = ble_compress(data, len, packed, sizeof(packed));
+    if (packed_len == 0 || ble_decompress(packed, packed_len, unpacked, sizeof(unpacked)) != len ||
+        memcmp(data, unpacked, len) != 0) {
+        fprintf(stderr, "%s: 解压结果不一致\n", name);
+        return 1;
+    }
+
+    // 每组数据处理约64MB
+    size_t iterations = (64u << 20) / len + 1;
+    volatile size_t sink = 0;
+    double start = now_sec();
+    for (size_t i = 0; i < iterations; i++) {
+        sink += ble_compress(data, len, packed, sizeof(packed));
+    }
+    double encode = now_sec() - start;
+    start = now_sec();
+    for (size_t i = 0; i < iterations; i++) {
+        sink += ble_decompress(packed, packed_len, unpacked, sizeof(unpacked));
+    }
+    double decode = now_sec() - start;
+    (void)sink;
+
+    printf("  %-14s %6zu -> %6zu 字节 (%5.1f%%)  A3包(64) %3u -> %3u  A3包(239) %3u -> %3u  "
+           "压缩 %7.1f MB/s  解压 %7.1f MB/s\n",
+           name, len, packed_len, 100.0 * packed_len / len,
+           packets(len, SEGMENT_LEGACY), packets(packed_len, SEGMENT_LEGACY),
+           packets(len, SEGMENT_MTU247), packets(packed_len, SEGMENT_MTU247),
+           len * iterations / encode / 1e6, len * iterations / decode / 1e6);
+    return 0;
+}
+
+// 随机数据和截断/损坏的压缩数据：不可压缩时返回0，解压不越界
+static int verify(uint8_t* buffer) {
+    static uint8_t packed[BLE_COMPRESS_BOUND(MAX_LEN)];
+    static uint8_t unpacked[MAX_LEN];
+
+    for (size_t len = 1; len <= 4096; len += 1 + len / 8) {
+        for (size_t i = 0; i < len; i++) {
+            buffer[i] = (rand() % 4 == 0) ? (uint8_t)rand() : 0;
+        }
+        size_t packed_len = ble_compress(buffer, len, packed, sizeof(packed));
+        if (packed_len == 0 || ble_decompress(packed, packed_len, unpacked, len) != len ||
+            memcmp(buffer, unpacked, len) != 0) {
+            fprintf(stderr, "结果不一致: len=%zu\n", len);
+            return 1;
+        }
+        // 输出缓冲区小于原始长度时，压缩失败或结果更短
+        size_t short_len = ble_compress(buffer, len, packed, len - 1);
+        if (short_len >= len) {
+            fprintf(stderr, "压缩结果超过缓冲区: len=%zu\n", len);
+            return 1;
+        }
+        // 损坏的数据只允许解压失败或输出不超过缓冲区
+        for (int j = 0; j < 16; j++) {
+            packed[rand() % packed_len] = (uint8_t)rand();
+            if (ble_decompress(packed, packed_len, unpacked, len) > len) {
+                fprintf(stderr, "解压越界: len=%zu\n", len);
+                return 1;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < MAX_LEN; i++) {
+        buffer[i] = (uint8_t)rand();
+    }
+    if (ble_compress(buffer, MAX_LEN, packed, MAX_LEN - 1) != 0) {
+        fprintf(stderr, "随机数据不应能压缩\n");
+        return 1;
+    }
+    if (ble_compress(buffer, MAX_LEN, packed, sizeof(packed)) == 0) {
+        fprintf(stderr, "BLE_COMPRESS_BOUND不足\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(void) {
+    static const size_t chars[] = {8, 32, 128, 512};
+    uint8_t* buffer = malloc(MAX_LEN);
+    if (buffer == NULL) {
+        return 1;
+    }
+
+    srand(1);
+    if (verify(buffer) != 0) {
+        free(buffer);
+        return 1;
+    }
+    printf("正确性校验通过\n");
+
+    // send_continuous_data()中的一组字模，每个字只出现一次
+    size_t len = 0;
+    for (size_t i = 0; i < CN_COUNT; i++) {
+        memcpy(buffer + len, m_glyph_cn[i], 32);
+        len += 32;
+    }
+    for (size_t i = 0; i < EN_COUNT - 1; i++) {
+        memcpy(buffer + len, m_glyph_en[i], 16);
+        len += 16;
+    }
+    int ret = bench("示例字模", buffer, len);
+
+    // 随机排列的一屏文字，重复的字可以整段回溯
+    char name[32];
+    for (size_t i = 0; i < sizeof(chars) / sizeof(chars[0]); i++) {
+        snprintf(name, sizeof(name), "汉字%zu个", chars[i]);
+        ret |= bench(name, buffer, make_text(buffer, chars[i], 100));
+        snprintf(name, sizeof(name), "混排%zu个", chars[i]);
+        ret |= bench(name, buffer, make_text(buffer, chars[i], 50));
+    }
+
+    free(buffer);
+    return ret;
+}
@@ -7,6 +7,12 @@
 #include <gattlib.h>
 #include <stdint.h>
 #include <time.h>
+#include <getopt.h>
+#include "ble_pacer.h"
+#include "ble_stats.h"
+
+#define ACK_PENDING_MAX 64          // 等待反馈的写入数上限，超过时丢弃最早的
+#define NOTIFY_READY_TIMEOUT_MS 2000
 
 
 
@@ -16,7 +22,15 @@ static struct {
     const char* mac_address;
     uuid_t char_uuid;
     int send_count;         // 发送次数
-    int interval_ms;        // 发送间隔(毫秒)
+    int interval_ms;        // 发送间隔(毫秒)，未指定速率时换算为包/秒
+    ble_pacer_unit_t rate_unit; // 速率单位
+    double rate;            // 目标速率 (字节/秒或包/秒)，0表示不限速
+    double burst;           // 突发量 (字节或包)
+    int retries;            // 写入失败时的重试次数
+    bool has_notify_uuid;   // 是否测量反馈RTT
+    uuid_t notify_uuid;     // 反馈通知特征 (设备每收到一个包发一个通知)
+    const char* json_path;  // JSON统计输出文件，"-"为标准输出，NULL不输出
+    const char* label;      // JSON中的测试标记 (固件版本、适配器、连接参数等)
     uint8_t* data_buffer;   // 发送数据缓冲区
     size_t data_len;        // 数据长度
 } m_config;
@@ -30,11 +44,52 @@ static struct {
     bool is_finished;
     int success_count;
     int fail_count;
+    ble_pacer_t pacer;      // 发送节奏
+    ble_stats_t stats;      // 延迟/吞吐量统计，由lock保护 (反馈在主循环线程记录)
+    int64_t ack_pending[ACK_PENDING_MAX];   // 等待反馈的写入开始时间 (环形队列)
+    int ack_head;
+    int ack_count;
 } m_state;
 
 // 全局变量：标记是否发现目标设备
 static bool device_found = false;
 
+// 反馈通知：与最早一个等待反馈的写入配对，计算RTT
+static void on_notification(const uuid_t* uuid, const uint8_t* data, size_t data_length, void* user_data) {
+    if (gattlib_uuid_cmp(uuid, &m_config.notify_uuid) != 0) {
+        return;
+    }
+    int64_t now = ble_stats_now_ns();
+    int64_t rtt_us = -1;
+
+    pthread_mutex_lock(&m_state.lock);
+    if (m_state.ack_count > 0) {
+        rtt_us = (now - m_state.ack_pending[m_state.ack_head]) / 1000;
+        m_state.ack_head = (m_state.ack_head + 1) % ACK_PENDING_MAX;
+        m_state.ack_count--;
+    }
+    ble_stats_record_ack(&m_state.stats, rtt_us);
+    pthread_mutex_unlock(&m_state.lock);
+}
+
+// 记录等待反馈的写入 (调用者持有lock)
+static void ack_push(int64_t sent_ns) {
+    if (m_state.ack_count == ACK_PENDING_MAX) {
+        m_state.ack_head = (m_state.ack_head + 1) % ACK_PENDING_MAX;
+        m_state.ack_count--;
+    }
+    m_state.ack_pending[(m_state.ack_head + m_state.ack_count) % ACK_PENDING_MAX] = sent_ns;
+    m_state.ack_count++;
+}
+
+// 写入最终失败时撤销 (调用者持有lock)，反馈已经先到时不再撤销
+static void ack_cancel(int64_t sent_ns) {
+    int tail = (m_state.ack_head + m_state.ack_count - 1) % ACK_PENDING_MAX;
+    if (m_state.ack_count > 0 && m_state.ack_pending[tail] == sent_ns) {
+        m_state.ack_count--;
+    }
+}
+
 // 连接回调函数
 static void on_connect(gattlib_adapter_t* adapter, const char* dst, 
                       gattlib_connection_t* connection, int error, void* user_data) {
@@ -48,6 +103,17 @@ static void on_connect(gattlib_adapter_t* adapter, const char* dst,
     }
 
     printf("成功连接到设备: %s\n", dst);
+    // 指定了反馈特征时启动通知，用于测量RTT
+    if (m_config.has_notify_uuid) {
+        int ret = gattlib_register_notification(connection, on_notification, NULL);
+        if (ret == 0) {
+            ret = gattlib_notification_start(connection, &m_config.notify_uuid);
+        }
+        if (ret != 0) {
+            fprintf(stderr, "启动通知监听失败: %d，不测量反馈RTT\n", ret);
+            m_config.has_notify_uuid = false;
+        }
+    }
     pthread_mutex_lock(&m_state.lock);
     m_state.connection = connection;
     m_state.is_connected = true;
@@ -82,18 +148,51 @@ static void send_continuous_data() {
     gattlib_connection_t* connection = m_state.connection;
     pthread_mutex_unlock(&m_state.lock);
 
-    // 循环发送数据
+    if (m_config.has_notify_uuid) {
+        int ret = gattlib_notification_wait_ready(connection, &m_config.notify_uuid, NOTIFY_READY_TIMEOUT_MS);
+        if (ret != 0) {
+            fprintf(stderr, "等待通知启用失败: %d，继续发送\n", ret);
+        }
+    }
+
+    // 循环发送数据，按令牌桶控制节奏 (截止时间是绝对时间，写入耗时不会使速率漂移)
+    ble_pacer_init(&m_state.pacer, m_config.rate_unit, m_config.rate, m_config.burst);
     for (int i = 0; i < m_config.send_count; i++) {
+        ble_pacer_wait(&m_state.pacer, m_config.data_len);
         printf("发送第 %d/%d 个包 (72字节字符数据: %s)... ", 
                i + 1, m_config.send_count, (char*)m_config.data_buffer);
 
-        // 发送72字节数据（GattLib自动处理长写/分片）
-        int ret = gattlib_write_char_by_uuid(
-            connection,
-            &m_config.char_uuid,
-            m_config.data_buffer,
-            m_config.data_len
-        );
+        // 反馈可能在写入调用返回前到达，先登记再写入
+        int64_t start = ble_stats_now_ns();
+        if (m_config.has_notify_uuid) {
+            pthread_mutex_lock(&m_state.lock);
+            ack_push(start);
+            pthread_mutex_unlock(&m_state.lock);
+        }
+
+        // 发送72字节数据（GattLib自动处理长写/分片），失败时按配置重试
+        int ret;
+        int retries = 0;
+        while (true) {
+            ret = gattlib_write_char_by_uuid(
+                connection,
+                &m_config.char_uuid,
+                m_config.data_buffer,
+                m_config.data_len
+            );
+            if (ret == 0 || retries >= m_config.retries) {
+                break;
+            }
+            retries++;
+        }
+        int64_t end = ble_stats_now_ns();
+
+        pthread_mutex_lock(&m_state.lock);
+        if (ret != 0 && m_config.has_notify_uuid) {
+            ack_cancel(start);
+        }
+        ble_stats_record_write(&m_state.stats, start, end, m_config.data_len, retries, ret == 0);
+        pthread_mutex_unlock(&m_state.lock);
 
         if (ret == 0) {
             printf("成功\n");
@@ -102,11 +201,6 @@ static void send_continuous_data() {
             printf("失败 (错误码: %d)\n", ret);
             m_state.fail_count++;
         }
-
-        // 最后一次发送不等待
-        if (i != m_config.send_count - 1) {
-            usleep(m_config.interval_ms * 1000);
-        }
     }
 
     // 标记完成
@@ -186,15 +280,66 @@ static void* ble_task(void* arg) {
 
 // 帮助信息
 static void usage(const char* program) {
-    printf("用法: %s <设备MAC> <特征UUID> <发送次数> <间隔毫秒>\n", program);
+    printf("用法: %s [选项] <设备MAC> <特征UUID> <发送次数> [间隔毫秒]\n", program);
+    printf("  -b <字节/秒>  目标速率 (字节/秒)\n");
+    printf("  -p <包/秒>    目标速率 (包/秒)\n");
+    printf("  -B <突发量>   空闲后允许连续发送的字节数或包数 (默认1个包)\n");
+    printf("  -r <次数>     写入失败时的重试次数 (默认0)\n");
+    printf("  -n <UUID>     设备反馈通知特征，测量写入到反馈的RTT\n");
+    printf("  -j <文件>     结束时把统计写成JSON (\"-\"为标准输出)\n");
+    printf("  -l <标记>     JSON中的测试标记，如固件版本/适配器/连接参数\n");
     printf("示例: %s 70:19:88:3D:30:68 0000ffe1-0000-1000-8000-00805f9b34fb 10 100\n", program);
-    printf("说明: 自动发送72字节字符数据（hello+67个x）\n");
+    printf("      %s -p 20 -B 5 70:19:88:3D:30:68 0000ffe1-0000-1000-8000-00805f9b34fb 1000\n", program);
+    printf("说明: 自动发送72字节字符数据（hello+67个x），未指定速率时按间隔毫秒发送，0表示不限速\n");
 }
 
 
 int main(int argc, char* argv[]) {
-    // 检查参数
-    if (argc != 5) {
+    int opt;
+
+    // 解析速率选项
+    m_config.rate_unit = BLE_PACER_PACKETS;
+    m_config.rate = -1;
+    m_config.burst = 0;
+    while ((opt = getopt(argc, argv, "b:p:B:r:n:j:l:h")) != -1) {
+        switch (opt) {
+        case 'b':
+            m_config.rate_unit = BLE_PACER_BYTES;
+            m_config.rate = atof(optarg);
+            break;
+        case 'p':
+            m_config.rate_unit = BLE_PACER_PACKETS;
+            m_config.rate = atof(optarg);
+            break;
+        case 'B':
+            m_config.burst = atof(optarg);
+            break;
+        case 'r':
+            m_config.retries = atoi(optarg);
+            break;
+        case 'n':
+            if (gattlib_string_to_uuid(optarg, strlen(optarg) + 1, &m_config.notify_uuid) != 0) {
+                fprintf(stderr, "无效的反馈UUID格式\n");
+                return 1;
+            }
+            m_config.has_notify_uuid = true;
+            break;
+        case 'j':
+            m_config.json_path = optarg;
+            break;
+        case 'l':
+            m_config.label = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    // 检查参数 (未指定速率时必须给出间隔)
+    if (argc != 5 && !(argc == 4 && m_config.rate >= 0)) {
         usage(argv[0]);
         return 1;
     }
@@ -206,13 +351,16 @@ int main(int argc, char* argv[]) {
     m_state.is_finished = false;
     m_state.success_count = 0;
     m_state.fail_count = 0;
+    m_state.ack_head = 0;
+    m_state.ack_count = 0;
+    ble_stats_init(&m_state.stats, 0);
     device_found = false;
 
     // 解析参数
     m_config.mac_address = argv[1];
     m_config.adapter_name = NULL;  // 使用默认适配器(hci0)
     m_config.send_count = atoi(argv[3]);
-    m_config.interval_ms = atoi(argv[4]);
+    m_config.interval_ms = (argc == 5) ? atoi(argv[4]) : 0;
     m_config.data_len = 72; // 固定72字节
     // 解析UUID
     if (gattlib_string_to_uuid(argv[2], strlen(argv[2]) + 1, &m_config.char_uuid) != 0) {
@@ -221,10 +369,17 @@ int main(int argc, char* argv[]) {
     }
 
     // 检查参数有效性
-    if (m_config.send_count <= 0 || m_config.interval_ms < 0 || m_config.data_len == 0) {
+    if (m_config.send_count <= 0 || m_config.interval_ms < 0 || m_config.retries < 0 || m_config.data_len == 0) {
         fprintf(stderr, "无效的参数值\n");
         return 1;
     }
+    // 只给出间隔时等价于每秒1000/间隔个包、不允许突发
+    if (m_config.rate < 0) {
+        m_config.rate = (m_config.interval_ms > 0) ? 1000.0 / m_config.interval_ms : 0;
+    }
+    if (m_config.burst < 1) {
+        m_config.burst = (m_config.rate_unit == BLE_PACER_BYTES) ? (double)m_config.data_len : 1;
+    }
     // 分配72字节缓冲区并生成字符数据
     m_config.data_buffer = malloc(m_config.data_len + 1); // +1用于字符串终止符
     if (!m_config.data_buffer) {
@@ -234,8 +389,10 @@ int main(int argc, char* argv[]) {
     generate_72bytes_char_data(m_config.data_buffer, m_config.data_len);
 
     // 启动主循环
-    printf("开始连续发送测试: 共%d个包, 间隔%dms, 72字节字符数据: %s\n",
-           m_config.send_count, m_config.interval_ms, (char*)m_config.data_buffer);
+    printf("开始连续发送测试: 共%d个包, 速率%.1f%s, 突发%.0f, 72字节字符数据: %s\n",
+           m_config.send_count, m_config.rate,
+           (m_config.rate_unit == BLE_PACER_BYTES) ? "字节/秒" : "包/秒",
+           m_config.burst, (char*)m_config.data_buffer);
 
     int ret = gattlib_mainloop(ble_task, NULL);
 
@@ -243,6 +400,27 @@ int main(int argc, char* argv[]) {
     printf("\n发送完成 - 成功: %d, 失败: %d, 总发送: %d\n",
            m_state.success_count, m_state.fail_count, m_config.send_count);
 
+    ble_pacer_report_t report;
+    ble_pacer_report(&m_state.pacer, &report);
+    printf("实际速率: %.1f %s (目标 %.1f)，发送间隔 %.1f±%.1f us，唤醒延迟 平均%.1f us 最大%.1f us\n",
+           report.rate, (m_config.rate_unit == BLE_PACER_BYTES) ? "字节/秒" : "包/秒", m_config.rate,
+           report.interval_mean_us, report.interval_jitter_us, report.late_mean_us, report.late_max_us);
+
+    // 延迟分位数和吞吐量 (统计在断开连接后读取，不需要加锁)
+    ble_stats_print(&m_state.stats, stdout);
+    if (m_config.json_path != NULL) {
+        bool to_stdout = (strcmp(m_config.json_path, "-") == 0);
+        FILE* fp = to_stdout ? stdout : fopen(m_config.json_path, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "无法写入JSON文件 %s\n", m_config.json_path);
+        } else {
+            ble_stats_write_json(&m_state.stats, m_config.label, fp);
+            if (!to_stdout) {
+                fclose(fp);
+            }
+        }
+    }
+
     // 清理资源
     free(m_config.data_buffer);
     pthread_mutex_destroy(&m_state.lock);
@@ -45,6 +45,7 @@ static void _on_device_connect(gattlib_connection_t* connection) {
 		goto EXIT;
 	}
 	connection->backend.dbus_objects = g_dbus_object_manager_get_objects(device_manager);
+	characteristic_cache_build(connection, device_manager);
 
 	gattlib_device_set_state(connection->device->adapter, connection->device->device_id, CONNECTED);
 
@@ -338,6 +339,8 @@ void gattlib_connection_free(gattlib_connection_t* connection) {
 	g_list_free_full(connection->backend.dbus_objects, g_object_unref);
 
 	disconnect_all_notifications(&connection->backend);
+	gattlib_notification_ring_stop(connection);
+	characteristic_cache_free(&connection->backend);
 
 	// Free all handler
 	//TODO: Fixme - there is a memory leak by not freeing the handlers
@@ -659,6 +659,58 @@ EXIT:
 	return ret;
 }
 
+int gattlib_adapter_register_known_device(gattlib_adapter_t* adapter, const char *mac_address) {
+	char object_path[GATTLIB_DBUS_OBJECT_PATH_SIZE_MAX];
+	GDBusObjectManager *device_manager;
+	GDBusInterface *interface;
+	GError *error = NULL;
+	int ret = GATTLIB_SUCCESS;
+
+	if (mac_address == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	g_rec_mutex_lock(&m_gattlib_mutex);
+
+	if (!gattlib_adapter_is_valid(adapter)) {
+		GATTLIB_LOG(GATTLIB_ERROR, "gattlib_adapter_register_known_device: Adapter not valid");
+		ret = GATTLIB_ADAPTER_CLOSE;
+		goto EXIT;
+	}
+
+	device_manager = get_device_manager_from_adapter(adapter, &error);
+	if (device_manager == NULL) {
+		if (error != NULL) {
+			ret = GATTLIB_ERROR_DBUS_WITH_ERROR(error);
+			g_error_free(error);
+		} else {
+			ret = GATTLIB_ERROR_DBUS;
+		}
+		goto EXIT;
+	}
+
+	// Use the same object path as gattlib_connect()
+	get_device_path_from_mac(adapter->name, mac_address, object_path, sizeof(object_path));
+
+	interface = g_dbus_object_manager_get_interface(device_manager, object_path, "org.bluez.Device1");
+	if (interface == NULL) {
+		GATTLIB_LOG(GATTLIB_DEBUG, "Device %s is not known by Bluez yet", mac_address);
+		ret = GATTLIB_NOT_FOUND;
+		goto EXIT;
+	}
+	g_object_unref(interface);
+
+	// Do not change the state of a device that is already tracked (eg: connecting or connected)
+	if (gattlib_device_get_state(adapter, object_path) == NOT_FOUND) {
+		GATTLIB_LOG(GATTLIB_DEBUG, "Register known device %s", mac_address);
+		ret = gattlib_device_set_state(adapter, object_path, DISCONNECTED);
+	}
+
+EXIT:
+	g_rec_mutex_unlock(&m_gattlib_mutex);
+	return ret;
+}
+
 int gattlib_adapter_close(gattlib_adapter_t* adapter) {
 	bool are_devices_disconnected;
 	int ret = GATTLIB_SUCCESS;
@@ -56,6 +56,19 @@ struct _gattlib_connection_backend {
 
 	// List of 'OrgBluezGattCharacteristic1*' which has an attached notification
 	GList *notified_characteristics;
+	// 'struct gattlib_notification_handle' of 'notified_characteristics' indexed by their
+	// 'OrgBluezGattCharacteristic1*' to route the notifications without parsing their UUID
+	GHashTable *notification_handles;
+
+	// GATT characteristics of the device resolved once services are resolved
+	// (array of 'struct gattlib_characteristic_cache_entry')
+	GArray *characteristic_cache;
+};
+
+struct gattlib_characteristic_cache_entry {
+	uuid_t uuid;
+	uint16_t handle;
+	OrgBluezGattCharacteristic1 *gatt;
 };
 
 struct _gattlib_adapter_backend {
@@ -103,6 +116,10 @@ int get_bluez_device_from_mac(struct _gattlib_adapter *adapter, const char *mac_
 
 struct dbus_characteristic get_characteristic_from_uuid(gattlib_connection_t* connection, const uuid_t* uuid);
 
+// Resolve the GATT characteristics of a connected device once (called with 'm_gattlib_mutex' held)
+void characteristic_cache_build(gattlib_connection_t* connection, GDBusObjectManager *device_manager);
+void characteristic_cache_free(struct _gattlib_connection_backend* backend);
+
 // Invoke when a new device has been discovered
 void gattlib_on_discovered_device(gattlib_adapter_t* gattlib_adapter, OrgBluezDevice1* device1);
 // Invoke when a new device is being connected
@@ -111,6 +128,9 @@ void gattlib_on_connected_device(gattlib_connection_t* connection);
 void gattlib_on_disconnected_device(gattlib_connection_t* connection);
 // Invoke when a new device receive a GATT notification
 void gattlib_on_gatt_notification(gattlib_connection_t* connection, const uuid_t* uuid, const uint8_t* data, size_t data_length);
+// Invoke when a GATT characteristic with its own handler receives a notification (handler NULL for the connection handler)
+void gattlib_on_gatt_notification_to_handler(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_event_handler_t handler, void* user_data, const uint8_t* data, size_t data_length);
 
 void disconnect_all_notifications(struct _gattlib_connection_backend* backend);
 
@@ -78,6 +78,107 @@ static bool handle_dbus_gattcharacteristic_from_path(struct _gattlib_connection_
 	return false;
 }
 
+// Object path is in the form '/org/bluez/hci0/dev_DE_79_A2_A1_E9_FA/service0024/char0025'.
+// We convert the last 4 hex characters into the handle
+static unsigned int get_handle_from_object_path(const char* object_path) {
+	unsigned int handle = 0;
+
+	sscanf(object_path + strlen(object_path) - 4, "%x", &handle);
+	return handle;
+}
+
+void characteristic_cache_build(gattlib_connection_t* connection, GDBusObjectManager *device_manager) {
+	struct _gattlib_connection_backend* backend = &connection->backend;
+	size_t device_path_len = strlen(backend->device_object_path);
+
+	characteristic_cache_free(backend);
+	backend->characteristic_cache = g_array_new(FALSE, TRUE, sizeof(struct gattlib_characteristic_cache_entry));
+
+	for (GList *l = backend->dbus_objects; l != NULL; l = l->next)  {
+		GDBusObject *object = l->data;
+		const char* object_path = g_dbus_object_get_object_path(G_DBUS_OBJECT(object));
+		GError *error = NULL;
+
+		// Only keep the characteristics of this device. The object path avoids the round trip
+		// to the GATT service used by handle_dbus_gattcharacteristic_from_path()
+		if ((strncmp(object_path, backend->device_object_path, device_path_len) != 0) ||
+		    (object_path[device_path_len] != '/')) {
+			continue;
+		}
+
+		GDBusInterface *interface = g_dbus_object_manager_get_interface(device_manager, object_path, "org.bluez.GattCharacteristic1");
+		if (interface == NULL) {
+			continue;
+		}
+		g_object_unref(interface);
+
+		OrgBluezGattCharacteristic1 *characteristic = org_bluez_gatt_characteristic1_proxy_new_for_bus_sync(
+				G_BUS_TYPE_SYSTEM,
+				G_DBUS_PROXY_FLAGS_NONE,
+				"org.bluez",
+				object_path,
+				NULL,
+				&error);
+		if (characteristic == NULL) {
+			if (error) {
+				GATTLIB_LOG(GATTLIB_ERROR, "Failed to get GATT characteristic %s: %s", object_path, error->message);
+				g_error_free(error);
+			}
+			continue;
+		}
+
+		const gchar *characteristic_uuid_str = org_bluez_gatt_characteristic1_get_uuid(characteristic);
+		if (characteristic_uuid_str == NULL) {
+			g_object_unref(characteristic);
+			continue;
+		}
+
+		struct gattlib_characteristic_cache_entry entry = {
+			.handle = get_handle_from_object_path(object_path),
+			.gatt = characteristic,
+		};
+		gattlib_string_to_uuid(characteristic_uuid_str, strlen(characteristic_uuid_str) + 1, &entry.uuid);
+		g_array_append_val(backend->characteristic_cache, entry);
+	}
+
+	GATTLIB_LOG(GATTLIB_DEBUG, "Resolved %d GATT characteristics for %s", backend->characteristic_cache->len, backend->device_object_path);
+}
+
+void characteristic_cache_free(struct _gattlib_connection_backend* backend) {
+	if (backend->characteristic_cache == NULL) {
+		return;
+	}
+
+	for (guint i = 0; i < backend->characteristic_cache->len; i++) {
+		struct gattlib_characteristic_cache_entry *entry =
+			&g_array_index(backend->characteristic_cache, struct gattlib_characteristic_cache_entry, i);
+		g_object_unref(entry->gatt);
+	}
+	g_array_free(backend->characteristic_cache, TRUE);
+	backend->characteristic_cache = NULL;
+}
+
+static struct gattlib_characteristic_cache_entry* characteristic_cache_find(struct _gattlib_connection_backend* backend,
+		const uuid_t* uuid, unsigned int handle)
+{
+	if (backend->characteristic_cache == NULL) {
+		return NULL;
+	}
+
+	for (guint i = 0; i < backend->characteristic_cache->len; i++) {
+		struct gattlib_characteristic_cache_entry *entry =
+			&g_array_index(backend->characteristic_cache, struct gattlib_characteristic_cache_entry, i);
+		if (uuid != NULL) {
+			if (gattlib_uuid_cmp(&entry->uuid, uuid) == 0) {
+				return entry;
+			}
+		} else if (entry->handle == handle) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
 #if BLUEZ_VERSION > BLUEZ_VERSIONS(5, 40)
 static bool handle_dbus_battery_from_uuid(struct _gattlib_connection_backend* backend, const uuid_t* uuid,
 		struct dbus_characteristic *dbus_characteristic, const char* object_path, GError **error)
@@ -115,6 +216,14 @@ struct dbus_characteristic get_characteristic_from_uuid(gattlib_connection_t* co
 		goto EXIT;
 	}
 
+	// Fast path: characteristic resolved after service discovery. The caller releases its own reference.
+	struct gattlib_characteristic_cache_entry *entry = characteristic_cache_find(&connection->backend, uuid, 0);
+	if (entry != NULL) {
+		dbus_characteristic.gatt = g_object_ref(entry->gatt);
+		dbus_characteristic.type = TYPE_GATT;
+		goto EXIT;
+	}
+
 	device_manager = get_device_manager_from_adapter(connection->device->adapter, &error);
 
 	if (device_manager == NULL) {
@@ -188,6 +297,14 @@ static struct dbus_characteristic get_characteristic_from_handle(gattlib_connect
 		goto EXIT;
 	}
 
+	// Fast path: characteristic resolved after service discovery. The caller releases its own reference.
+	struct gattlib_characteristic_cache_entry *entry = characteristic_cache_find(&connection->backend, NULL, handle);
+	if (entry != NULL) {
+		dbus_characteristic.gatt = g_object_ref(entry->gatt);
+		dbus_characteristic.type = TYPE_GATT;
+		goto EXIT;
+	}
+
 	device_manager = get_device_manager_from_adapter(connection->device->adapter, &error);
 
 	if (device_manager == NULL) {
@@ -210,10 +327,7 @@ static struct dbus_characteristic get_characteristic_from_handle(gattlib_connect
 		if (interface) {
 			g_object_unref(interface);
 
-			// Object path is in the form '/org/bluez/hci0/dev_DE_79_A2_A1_E9_FA/service0024'.
-			// We convert the last 4 hex characters into the handle
-			sscanf(object_path + strlen(object_path) - 4, "%x", &char_handle);
-
+			char_handle = get_handle_from_object_path(object_path);
 			if (char_handle != handle) {
 				continue;
 			}
@@ -503,6 +617,32 @@ int gattlib_write_without_response_char_by_handle(gattlib_connection_t* connecti
 	return ret;
 }
 
+int gattlib_get_handle_from_uuid(gattlib_connection_t* connection, const uuid_t* uuid, uint16_t* handle) {
+	int ret = GATTLIB_SUCCESS;
+
+	if ((uuid == NULL) || (handle == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	g_rec_mutex_lock(&m_gattlib_mutex);
+
+	if (!gattlib_connection_is_connected(connection)) {
+		ret = GATTLIB_INVALID_PARAMETER;
+		goto EXIT;
+	}
+
+	struct gattlib_characteristic_cache_entry *entry = characteristic_cache_find(&connection->backend, uuid, 0);
+	if (entry == NULL) {
+		ret = GATTLIB_NOT_FOUND;
+		goto EXIT;
+	}
+	*handle = entry->handle;
+
+EXIT:
+	g_rec_mutex_unlock(&m_gattlib_mutex);
+	return ret;
+}
+
 void gattlib_characteristic_free_value(void *ptr) {
 	free(ptr);
 }
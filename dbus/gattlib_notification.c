@@ -4,19 +4,370 @@
  * Copyright (c) 2016-2024, Olivier Martin <olivier@labapart.org>
  */
 
+// recvmmsg()
+#define _GNU_SOURCE
+
+#include <errno.h>
 #include <glib.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gio/gunixfdlist.h>
 
 #include "gattlib_internal.h"
 
+// Maximum number of notifications read from an AcquireNotify socket with a single recvmmsg()
+#define GATTLIB_NOTIFICATION_ACQUIRED_BATCH	16
+
+/**
+ * Characteristic notified through the socket returned by 'AcquireNotify'
+ *
+ * Bluez writes every notification as a message on the socket. It skips the 'PropertiesChanged' signal
+ * and our GVariant parsing. A reader thread receives the messages.
+ */
+struct gattlib_notification_acquired {
+	gattlib_connection_t* connection;
+	uuid_t uuid;
+	// Handler of the characteristic. NULL to use the connection handler.
+	gattlib_event_handler_t handler;
+	void* user_data;
+	int fd;
+	uint16_t mtu;
+	// eventfd used to stop the reader thread
+	int wakeup_fd;
+	GThread *thread;
+	// Set with 'm_gattlib_mutex' held when notifications are stopped. The reader checks it with the
+	// same mutex and does not access the connection anymore once it is set.
+	bool stopping;
+	// Owned by the reader thread and the notification handle. The last one frees it.
+	int reference_counter;
+};
+
 struct gattlib_notification_handle {
 	OrgBluezGattCharacteristic1 *gatt;
+	// 0 when notifications are received through 'acquired'
 	gulong signal_id;
+	struct gattlib_notification_acquired *acquired;
 	uuid_t uuid;
+	// Handler of the characteristic. NULL to use the connection handler.
+	gattlib_event_handler_t handler;
+	void* user_data;
+	// Set when the characteristic 'Notifying' property is TRUE (protected by 'm_gattlib_signal.mutex')
+	bool notifying;
+	// One-shot handler called when 'notifying' becomes true
+	gattlib_notification_ready_handler_t ready_handler;
+	void* ready_user_data;
 };
 
+static struct gattlib_notification_handle* find_notification_handle(gattlib_connection_t* connection, const uuid_t* uuid) {
+	for (GList *l = connection->backend.notified_characteristics; l != NULL; l = l->next) {
+		struct gattlib_notification_handle *notification_handle = l->data;
+		if (gattlib_uuid_cmp(&notification_handle->uuid, uuid) == GATTLIB_SUCCESS) {
+			return notification_handle;
+		}
+	}
+	return NULL;
+}
+
+static void notification_handle_add(gattlib_connection_t* connection, struct gattlib_notification_handle *notification_handle) {
+	connection->backend.notified_characteristics = g_list_append(connection->backend.notified_characteristics, notification_handle);
+
+	if (connection->backend.notification_handles == NULL) {
+		connection->backend.notification_handles = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+	g_hash_table_insert(connection->backend.notification_handles, notification_handle->gatt, notification_handle);
+}
+
+static void notification_handle_remove(gattlib_connection_t* connection, struct gattlib_notification_handle *notification_handle) {
+	connection->backend.notified_characteristics = g_list_remove(connection->backend.notified_characteristics, notification_handle);
+
+	// The characteristic might have been registered again (eg: for indications)
+	if ((connection->backend.notification_handles != NULL) &&
+	    (g_hash_table_lookup(connection->backend.notification_handles, notification_handle->gatt) == notification_handle)) {
+		g_hash_table_remove(connection->backend.notification_handles, notification_handle->gatt);
+	}
+}
+
+/**
+ * Update the notification state of a characteristic and call the pending 'ready' handler
+ *
+ * It must be called with 'm_gattlib_mutex' held.
+ */
+static void notification_set_notifying(gattlib_connection_t* connection, struct gattlib_notification_handle *notification_handle,
+		bool notifying)
+{
+	g_mutex_lock(&m_gattlib_signal.mutex);
+	bool was_notifying = notification_handle->notifying;
+	notification_handle->notifying = notifying;
+	if (notifying && !was_notifying) {
+		m_gattlib_signal.signals |= GATTLIB_SIGNAL_NOTIFICATION_READY;
+		g_cond_broadcast(&m_gattlib_signal.condition);
+	}
+	g_mutex_unlock(&m_gattlib_signal.mutex);
+
+	if (notifying && notification_handle->ready_handler) {
+		gattlib_notification_ready_handler_t ready_handler = notification_handle->ready_handler;
+
+		notification_handle->ready_handler = NULL;
+		ready_handler(connection, &notification_handle->uuid, notification_handle->ready_user_data);
+	}
+}
+
+/**
+ * Track the 'Notifying' property of a GATT characteristic
+ *
+ * It must be called with 'm_gattlib_mutex' held.
+ */
+static void on_characteristic_notifying_change(gattlib_connection_t* connection, OrgBluezGattCharacteristic1 *object,
+		GVariant *arg_changed_properties)
+{
+	GVariantDict dict;
+	g_variant_dict_init(&dict, arg_changed_properties);
+
+	GVariant* notifying = g_variant_dict_lookup_value(&dict, "Notifying", G_VARIANT_TYPE_BOOLEAN);
+	if (notifying != NULL) {
+		for (GList *l = connection->backend.notified_characteristics; l != NULL; l = l->next) {
+			struct gattlib_notification_handle *notification_handle = l->data;
+			if (notification_handle->gatt == object) {
+				GATTLIB_LOG(GATTLIB_DEBUG, "on_characteristic_notifying_change: Notifying=%d", g_variant_get_boolean(notifying));
+				notification_set_notifying(connection, notification_handle, g_variant_get_boolean(notifying));
+				break;
+			}
+		}
+		g_variant_unref(notifying);
+	}
+
+	g_variant_dict_end(&dict);
+}
+
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 48)
+static void notification_acquired_unref(struct gattlib_notification_acquired *acquired) {
+	if (__atomic_sub_fetch(&acquired->reference_counter, 1, __ATOMIC_ACQ_REL) == 0) {
+		close(acquired->fd);
+		close(acquired->wakeup_fd);
+		free(acquired);
+	}
+}
+
+static gpointer notification_acquired_thread(gpointer data) {
+	struct gattlib_notification_acquired *acquired = data;
+	struct mmsghdr messages[GATTLIB_NOTIFICATION_ACQUIRED_BATCH];
+	struct iovec iovecs[GATTLIB_NOTIFICATION_ACQUIRED_BATCH];
+	uint8_t *buffers;
+
+	// A notification cannot be larger than the ATT MTU
+	buffers = malloc(GATTLIB_NOTIFICATION_ACQUIRED_BATCH * acquired->mtu);
+	if (buffers == NULL) {
+		GATTLIB_LOG(GATTLIB_ERROR, "notification_acquired_thread: Failed to allocate buffers");
+		goto EXIT;
+	}
+
+	memset(messages, 0, sizeof(messages));
+	for (int i = 0; i < GATTLIB_NOTIFICATION_ACQUIRED_BATCH; i++) {
+		iovecs[i].iov_base = buffers + i * acquired->mtu;
+		iovecs[i].iov_len = acquired->mtu;
+		messages[i].msg_hdr.msg_iov = &iovecs[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	struct pollfd fds[2] = {
+		{ .fd = acquired->fd, .events = POLLIN },
+		{ .fd = acquired->wakeup_fd, .events = POLLIN },
+	};
+
+	for (;;) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			GATTLIB_LOG(GATTLIB_ERROR, "notification_acquired_thread: poll failed (errno=%d)", errno);
+			break;
+		}
+		if (fds[1].revents != 0) {
+			break;
+		}
+
+		// Read all the pending notifications at once
+		int count = recvmmsg(acquired->fd, messages, GATTLIB_NOTIFICATION_ACQUIRED_BATCH, MSG_DONTWAIT, NULL);
+		if (count < 0) {
+			if ((errno == EAGAIN) || (errno == EINTR)) {
+				continue;
+			}
+			GATTLIB_LOG(GATTLIB_ERROR, "notification_acquired_thread: recvmmsg failed (errno=%d)", errno);
+			break;
+		}
+
+		bool closed = false;
+
+		// Only check the connection with the global mutex. The device reference keeps the connection
+		// valid while the notifications are queued without it.
+		g_rec_mutex_lock(&m_gattlib_mutex);
+
+		if (acquired->stopping) {
+			g_rec_mutex_unlock(&m_gattlib_mutex);
+			break;
+		}
+
+		bool dispatch = gattlib_connection_is_connected(acquired->connection) &&
+			((acquired->handler != NULL) || gattlib_has_notification_handler(acquired->connection));
+		if (dispatch) {
+			gattlib_device_ref(acquired->connection->device);
+		}
+
+		g_rec_mutex_unlock(&m_gattlib_mutex);
+
+		for (int i = 0; i < count; i++) {
+			// Bluez closes the socket when the device disconnects or another client stops the notifications
+			if (messages[i].msg_len == 0) {
+				closed = true;
+				break;
+			}
+			if (messages[i].msg_hdr.msg_flags & MSG_TRUNC) {
+				GATTLIB_LOG(GATTLIB_ERROR, "notification_acquired_thread: Notification larger than MTU (%d bytes)", acquired->mtu);
+			}
+
+			if (dispatch) {
+				gattlib_on_gatt_notification_to_handler(acquired->connection, &acquired->uuid,
+						acquired->handler, acquired->user_data,
+						iovecs[i].iov_base, messages[i].msg_len);
+			}
+		}
+
+		if (dispatch) {
+			gattlib_device_unref(acquired->connection->device);
+		}
+
+		if (closed || (count == 0)) {
+			GATTLIB_LOG(GATTLIB_DEBUG, "notification_acquired_thread: Notification socket closed");
+			break;
+		}
+	}
+
+EXIT:
+	free(buffers);
+	notification_acquired_unref(acquired);
+	return NULL;
+}
+
+/**
+ * Ask the reader thread of a characteristic notified through 'AcquireNotify' to stop
+ *
+ * It must be called with 'm_gattlib_mutex' held. The reader checks 'stopping' under this mutex
+ * before queuing a batch, so no new notification is queued once it returns.
+ * Closing the socket disables the notifications.
+ */
+static void notification_acquired_stop(struct gattlib_notification_acquired *acquired) {
+	uint64_t value = 1;
+
+	acquired->stopping = true;
+	if (write(acquired->wakeup_fd, &value, sizeof(value)) < 0) {
+		GATTLIB_LOG(GATTLIB_ERROR, "notification_acquired_stop: Failed to wake up the reader (errno=%d)", errno);
+	}
+}
+
+/**
+ * Release a reader thread stopped by notification_acquired_stop()
+ *
+ * When 'join' is set, it waits for the thread to exit. It must then be called without 'm_gattlib_mutex'
+ * as the reader takes it. Otherwise the thread exits on its own and releases its reference; the batch
+ * it might still be queuing holds a reference on the device.
+ */
+static void notification_acquired_release(struct gattlib_notification_acquired *acquired, bool join) {
+	if (join) {
+		g_thread_join(acquired->thread);
+	} else {
+		g_thread_unref(acquired->thread);
+	}
+	notification_acquired_unref(acquired);
+}
+
+/**
+ * Acquire the notification socket of a GATT characteristic and start its reader thread
+ *
+ * It must be called with 'm_gattlib_mutex' held.
+ */
+static int notification_acquire(gattlib_connection_t* connection, const uuid_t* uuid,
+		OrgBluezGattCharacteristic1 *gatt, gattlib_event_handler_t handler, void* user_data,
+		struct gattlib_notification_acquired **acquired_out)
+{
+	struct gattlib_notification_acquired *acquired;
+	GError *error = NULL;
+	GUnixFDList *fd_list = NULL;
+	GVariant *out_fd = NULL;
+	uint16_t mtu;
+	int ret;
+	int fd;
+
+	GVariantBuilder *variant_options = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+
+	org_bluez_gatt_characteristic1_call_acquire_notify_sync(
+		gatt,
+		g_variant_builder_end(variant_options),
+		NULL /* fd_list */,
+		&out_fd, &mtu,
+		&fd_list,
+		NULL /* cancellable */, &error);
+
+	g_variant_builder_unref(variant_options);
+
+	if (error != NULL) {
+		ret = GATTLIB_ERROR_DBUS_WITH_ERROR(error);
+		GATTLIB_LOG(GATTLIB_DEBUG, "Failed to acquire DBus GATT notification: %s", error->message);
+		g_error_free(error);
+		return ret;
+	}
+
+	fd = g_unix_fd_list_get(fd_list, g_variant_get_handle(out_fd), &error);
+	g_variant_unref(out_fd);
+	g_object_unref(fd_list);
+	if (error != NULL) {
+		ret = GATTLIB_ERROR_DBUS_WITH_ERROR(error);
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to retrieve Unix File Descriptor: %s", error->message);
+		g_error_free(error);
+		return ret;
+	}
+
+	acquired = calloc(sizeof(struct gattlib_notification_acquired), 1);
+	if (acquired == NULL) {
+		close(fd);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	acquired->connection = connection;
+	memcpy(&acquired->uuid, uuid, sizeof(*uuid));
+	acquired->handler = handler;
+	acquired->user_data = user_data;
+	acquired->fd = fd;
+	acquired->mtu = mtu;
+	acquired->reference_counter = 2;
+
+	acquired->wakeup_fd = eventfd(0, EFD_CLOEXEC);
+	if (acquired->wakeup_fd < 0) {
+		ret = GATTLIB_ERROR_UNIX_WITH_ERROR(errno);
+		close(fd);
+		free(acquired);
+		return ret;
+	}
+
+	acquired->thread = g_thread_try_new("gattlib_notification_acquired", notification_acquired_thread, acquired, &error);
+	if (acquired->thread == NULL) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to create the notification reader thread: %s", error->message);
+		g_error_free(error);
+		close(fd);
+		close(acquired->wakeup_fd);
+		free(acquired);
+		return GATTLIB_ERROR_INTERNAL;
+	}
+
+	*acquired_out = acquired;
+	return GATTLIB_SUCCESS;
+}
+#endif /* #if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 48) */
+
 #if BLUEZ_VERSION > BLUEZ_VERSIONS(5, 40)
 gboolean on_handle_battery_level_property_change(
 		OrgBluezBattery1 *object,
@@ -38,7 +389,7 @@ gboolean on_handle_battery_level_property_change(
 		return FALSE;
 	}
 
-	if (gattlib_has_valid_handler(&connection->notification)) {
+	if (gattlib_has_notification_handler(connection)) {
 		// Retrieve 'Value' from 'arg_changed_properties'
 		if (g_variant_n_children (arg_changed_properties) > 0) {
 			GVariantIter *iter;
@@ -81,14 +432,22 @@ static gboolean on_handle_characteristic_property_change(
 		return FALSE;
 	}
 
-	if (gattlib_has_valid_handler(&connection->notification)) {
+	on_characteristic_notifying_change(connection, object, arg_changed_properties);
+
+	// The characteristic (and its UUID) has been resolved when its notifications have been started
+	struct gattlib_notification_handle *notification_handle = NULL;
+	if (connection->backend.notification_handles != NULL) {
+		notification_handle = g_hash_table_lookup(connection->backend.notification_handles, object);
+	}
+
+	if ((notification_handle != NULL) &&
+	    ((notification_handle->handler != NULL) || gattlib_has_notification_handler(connection))) {
 		GVariantDict dict;
 		g_variant_dict_init(&dict, arg_changed_properties);
 
 		// Retrieve 'Value' from 'arg_changed_properties'
 		GVariant* value = g_variant_dict_lookup_value(&dict, "Value", NULL);
 		if (value != NULL) {
-			uuid_t uuid;
 			size_t data_length;
 			const uint8_t* data = g_variant_get_fixed_array(value, &data_length, sizeof(guchar));
 
@@ -96,12 +455,9 @@ static gboolean on_handle_characteristic_property_change(
 			//GATTLIB_LOG(GATTLIB_DEBUG, "on_handle_characteristic_property_change: %s: %s", key, g_variant_print(value, TRUE));
 			GATTLIB_LOG(GATTLIB_DEBUG, "on_handle_characteristic_property_change: Value: Received %d bytes", data_length);
 
-			gattlib_string_to_uuid(
-					org_bluez_gatt_characteristic1_get_uuid(object),
-					MAX_LEN_UUID_STR + 1,
-					&uuid);
-
-			gattlib_on_gatt_notification(connection, &uuid, data, data_length);
+			gattlib_on_gatt_notification_to_handler(connection, &notification_handle->uuid,
+					notification_handle->handler, notification_handle->user_data,
+					data, data_length);
 
 			// As per https://developer.gnome.org/glib/stable/glib-GVariant.html#g-variant-iter-loop, clean up `key` and `value`.
 			g_variant_unref(value);
@@ -124,6 +480,12 @@ static gboolean on_handle_characteristic_indication(
 {
 	gattlib_connection_t* connection = user_data;
 
+	g_rec_mutex_lock(&m_gattlib_mutex);
+	if (gattlib_connection_is_connected(connection)) {
+		on_characteristic_notifying_change(connection, object, arg_changed_properties);
+	}
+	g_rec_mutex_unlock(&m_gattlib_mutex);
+
 	if (gattlib_has_valid_handler(&connection->indication)) {
 		// Retrieve 'Value' from 'arg_changed_properties'
 		if (g_variant_n_children (arg_changed_properties) > 0) {
@@ -158,7 +520,8 @@ static gboolean on_handle_characteristic_indication(
 	return TRUE;
 }
 
-static int connect_signal_to_characteristic_uuid(gattlib_connection_t* connection, const uuid_t* uuid, void *callback) {
+static int connect_signal_to_characteristic_uuid(gattlib_connection_t* connection, const uuid_t* uuid, void *callback,
+		gattlib_event_handler_t handler, void* user_data) {
 	int ret = GATTLIB_SUCCESS;
 
 	assert(callback != NULL);
@@ -182,6 +545,12 @@ static int connect_signal_to_characteristic_uuid(gattlib_connection_t* connectio
 	}
 #if BLUEZ_VERSION > BLUEZ_VERSIONS(5, 40)
 	else if (dbus_characteristic.type == TYPE_BATTERY_LEVEL) {
+		// Battery Level notifications are only dispatched to the connection handler
+		if (handler != NULL) {
+			ret = GATTLIB_NOT_SUPPORTED;
+			goto EXIT;
+		}
+
 		// Register a handle for notification
 		g_signal_connect(dbus_characteristic.battery,
 			"g-properties-changed",
@@ -195,6 +564,13 @@ static int connect_signal_to_characteristic_uuid(gattlib_connection_t* connectio
 	}
 #endif
 
+	if (handler != NULL) {
+		ret = gattlib_notification_dispatch_init(connection);
+		if (ret != GATTLIB_SUCCESS) {
+			goto EXIT;
+		}
+	}
+
 	// Register a handle for notification
 	gulong signal_id = g_signal_connect(dbus_characteristic.gatt,
 		"g-properties-changed",
@@ -215,7 +591,9 @@ static int connect_signal_to_characteristic_uuid(gattlib_connection_t* connectio
 	notification_handle->gatt = dbus_characteristic.gatt;
 	notification_handle->signal_id = signal_id;
 	memcpy(&notification_handle->uuid, uuid, sizeof(*uuid));
-	connection->backend.notified_characteristics = g_list_append(connection->backend.notified_characteristics, notification_handle);
+	notification_handle->handler = handler;
+	notification_handle->user_data = user_data;
+	notification_handle_add(connection, notification_handle);
 
 	// Note: An optimisation could be to release mutex here after increasing reference counter of 'dbus_characteristic.gatt'
 
@@ -228,6 +606,12 @@ static int connect_signal_to_characteristic_uuid(gattlib_connection_t* connectio
 		goto EXIT;
 	}
 
+	// The 'Notifying' property might already be set (eg: the change has been received before the reply
+	// or another client enabled the notifications). Otherwise the property change handler catches it.
+	if (org_bluez_gatt_characteristic1_get_notifying(dbus_characteristic.gatt)) {
+		notification_set_notifying(connection, notification_handle, true);
+	}
+
 EXIT:
 	g_rec_mutex_unlock(&m_gattlib_mutex);
 	return ret;
@@ -235,6 +619,9 @@ EXIT:
 
 static int disconnect_signal_to_characteristic_uuid(gattlib_connection_t* connection, const uuid_t* uuid, void *callback) {
 	struct gattlib_notification_handle *notification_handle = NULL;
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 48)
+	struct gattlib_notification_acquired *acquired = NULL;
+#endif
 	int ret = GATTLIB_SUCCESS;
 
 	g_rec_mutex_lock(&m_gattlib_mutex);
@@ -245,20 +632,22 @@ static int disconnect_signal_to_characteristic_uuid(gattlib_connection_t* connec
 	}
 
 	// Find notification handle
-	for (GList *l = connection->backend.notified_characteristics; l != NULL; l = l->next) {
-		struct gattlib_notification_handle *notification_handle_ptr = l->data;
-		if (gattlib_uuid_cmp(&notification_handle_ptr->uuid, uuid) == GATTLIB_SUCCESS) {
-			notification_handle = notification_handle_ptr;
-
-			connection->backend.notified_characteristics = g_list_delete_link(connection->backend.notified_characteristics, l);
-			break;
-		}
-	}
-
+	notification_handle = find_notification_handle(connection, uuid);
 	if (notification_handle == NULL) {
 		ret = GATTLIB_NOT_FOUND;
 		goto EXIT;
 	}
+	notification_handle_remove(connection, notification_handle);
+
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 48)
+	if (notification_handle->acquired != NULL) {
+		// Closing the socket is enough for Bluez to stop the notifications
+		acquired = notification_handle->acquired;
+		notification_acquired_stop(acquired);
+		free(notification_handle);
+		goto EXIT;
+	}
+#endif
 
 	g_signal_handler_disconnect(notification_handle->gatt, notification_handle->signal_id);
 
@@ -277,19 +666,175 @@ static int disconnect_signal_to_characteristic_uuid(gattlib_connection_t* connec
 
 EXIT:
 	g_rec_mutex_unlock(&m_gattlib_mutex);
+
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 48)
+	// Wait for the reader outside of 'm_gattlib_mutex' so no handler runs on its thread once we return
+	if (acquired != NULL) {
+		notification_acquired_release(acquired, true);
+	}
+#endif
 	return ret;
 }
 
 int gattlib_notification_start(gattlib_connection_t* connection, const uuid_t* uuid) {
-	return connect_signal_to_characteristic_uuid(connection, uuid, on_handle_characteristic_property_change);
+	return gattlib_notification_start_with_handler(connection, uuid, NULL, NULL);
+}
+
+int gattlib_notification_start_with_handler(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_event_handler_t notification_handler, void* user_data)
+{
+	return connect_signal_to_characteristic_uuid(connection, uuid, on_handle_characteristic_property_change,
+			notification_handler, user_data);
+}
+
+int gattlib_notification_start_acquired(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_event_handler_t notification_handler, void* user_data)
+{
+#if BLUEZ_VERSION < BLUEZ_VERSIONS(5, 48)
+	return gattlib_notification_start_with_handler(connection, uuid, notification_handler, user_data);
+#else
+	struct gattlib_notification_acquired *acquired = NULL;
+	int ret = GATTLIB_SUCCESS;
+
+	g_rec_mutex_lock(&m_gattlib_mutex);
+
+	if (!gattlib_connection_is_connected(connection)) {
+		ret = GATTLIB_INVALID_PARAMETER;
+		goto EXIT;
+	}
+
+	struct dbus_characteristic dbus_characteristic = get_characteristic_from_uuid(connection, uuid);
+	if (dbus_characteristic.type != TYPE_GATT) {
+		// Not found or Battery Level. gattlib_notification_start_with_handler() handles them.
+		ret = gattlib_notification_start_with_handler(connection, uuid, notification_handler, user_data);
+		goto EXIT;
+	}
+
+	if (notification_handler != NULL) {
+		ret = gattlib_notification_dispatch_init(connection);
+		if (ret != GATTLIB_SUCCESS) {
+			goto EXIT;
+		}
+	}
+
+	// Bluez refuses to give the socket if the characteristic does not support notifications
+	// (eg: indications) or if another client already enabled them
+	ret = notification_acquire(connection, uuid, dbus_characteristic.gatt, notification_handler, user_data, &acquired);
+	if (ret != GATTLIB_SUCCESS) {
+		GATTLIB_LOG(GATTLIB_INFO, "Cannot acquire the notification socket, fallback on D-Bus notifications");
+		ret = gattlib_notification_start_with_handler(connection, uuid, notification_handler, user_data);
+		goto EXIT;
+	}
+
+	struct gattlib_notification_handle *notification_handle = calloc(sizeof(struct gattlib_notification_handle), 1);
+	if (notification_handle == NULL) {
+		notification_acquired_stop(acquired);
+		notification_acquired_release(acquired, false);
+		ret = GATTLIB_OUT_OF_MEMORY;
+		goto EXIT;
+	}
+	notification_handle->gatt = dbus_characteristic.gatt;
+	notification_handle->acquired = acquired;
+	memcpy(&notification_handle->uuid, uuid, sizeof(*uuid));
+	notification_handle->handler = notification_handler;
+	notification_handle->user_data = user_data;
+	notification_handle_add(connection, notification_handle);
+
+	// Bluez has written the CCCD before returning the socket
+	notification_set_notifying(connection, notification_handle, true);
+
+EXIT:
+	g_rec_mutex_unlock(&m_gattlib_mutex);
+	return ret;
+#endif
 }
 
 int gattlib_notification_stop(gattlib_connection_t* connection, const uuid_t* uuid) {
 	return disconnect_signal_to_characteristic_uuid(connection, uuid, on_handle_characteristic_property_change);
 }
 
+int gattlib_notification_on_ready(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_notification_ready_handler_t ready_handler, void* user_data)
+{
+	int ret = GATTLIB_SUCCESS;
+
+	if (ready_handler == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	g_rec_mutex_lock(&m_gattlib_mutex);
+
+	if (!gattlib_connection_is_connected(connection)) {
+		ret = GATTLIB_INVALID_PARAMETER;
+		goto EXIT;
+	}
+
+	struct gattlib_notification_handle *notification_handle = find_notification_handle(connection, uuid);
+	if (notification_handle == NULL) {
+		ret = GATTLIB_NOT_FOUND;
+		goto EXIT;
+	}
+
+	g_mutex_lock(&m_gattlib_signal.mutex);
+	bool notifying = notification_handle->notifying;
+	g_mutex_unlock(&m_gattlib_signal.mutex);
+
+	if (notifying) {
+		ready_handler(connection, uuid, user_data);
+	} else {
+		notification_handle->ready_handler = ready_handler;
+		notification_handle->ready_user_data = user_data;
+	}
+
+EXIT:
+	g_rec_mutex_unlock(&m_gattlib_mutex);
+	return ret;
+}
+
+int gattlib_notification_wait_ready(gattlib_connection_t* connection, const uuid_t* uuid, unsigned int timeout_ms) {
+	gint64 end_time = g_get_monotonic_time() + (gint64)timeout_ms * G_TIME_SPAN_MILLISECOND;
+	int ret = GATTLIB_SUCCESS;
+
+	for (;;) {
+		g_rec_mutex_lock(&m_gattlib_mutex);
+
+		if (!gattlib_connection_is_connected(connection)) {
+			g_rec_mutex_unlock(&m_gattlib_mutex);
+			ret = GATTLIB_DEVICE_DISCONNECTED;
+			break;
+		}
+
+		struct gattlib_notification_handle *notification_handle = find_notification_handle(connection, uuid);
+		if (notification_handle == NULL) {
+			g_rec_mutex_unlock(&m_gattlib_mutex);
+			ret = GATTLIB_NOT_FOUND;
+			break;
+		}
+
+		// Take the signal mutex before releasing 'm_gattlib_mutex' to not miss the broadcast
+		g_mutex_lock(&m_gattlib_signal.mutex);
+		bool notifying = notification_handle->notifying;
+		g_rec_mutex_unlock(&m_gattlib_mutex);
+
+		if (notifying) {
+			g_mutex_unlock(&m_gattlib_signal.mutex);
+			break;
+		}
+
+		// Woken up on any gattlib signal (including disconnection), the state is checked again
+		gboolean signalled = g_cond_wait_until(&m_gattlib_signal.condition, &m_gattlib_signal.mutex, end_time);
+		g_mutex_unlock(&m_gattlib_signal.mutex);
+		if (!signalled) {
+			ret = GATTLIB_TIMEOUT;
+			break;
+		}
+	}
+
+	return ret;
+}
+
 int gattlib_indication_start(gattlib_connection_t* connection, const uuid_t* uuid) {
-	return connect_signal_to_characteristic_uuid(connection, uuid, on_handle_characteristic_indication);
+	return connect_signal_to_characteristic_uuid(connection, uuid, on_handle_characteristic_indication, NULL, NULL);
 }
 
 int gattlib_indication_stop(gattlib_connection_t* connection, const uuid_t* uuid) {
@@ -299,10 +844,21 @@ int gattlib_indication_stop(gattlib_connection_t* connection, const uuid_t* uuid
 static void end_notification(void *notified_characteristic) {
 	struct gattlib_notification_handle *notification_handle = notified_characteristic;
 
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 48)
+	if (notification_handle->acquired != NULL) {
+		// Called on disconnection with 'm_gattlib_mutex' held, we cannot wait for the reader
+		notification_acquired_stop(notification_handle->acquired);
+		notification_acquired_release(notification_handle->acquired, false);
+		free(notification_handle);
+		return;
+	}
+#endif
+
 	g_signal_handler_disconnect(notification_handle->gatt, notification_handle->signal_id);
 	free(notification_handle);
 }
 
 void disconnect_all_notifications(struct _gattlib_connection_backend* backend) {
+	g_clear_pointer(&backend->notification_handles, g_hash_table_destroy);
 	g_list_free_full(g_steal_pointer(&backend->notified_characteristics), end_notification);
 }
@@ -199,6 +199,10 @@ gattlib_characteristic_free_value.argtypes = [c_void_p]
 gattlib_write_char_by_uuid = gattlib.gattlib_write_char_by_uuid
 gattlib_write_char_by_uuid.argtypes = [c_void_p, POINTER(GattlibUuid), c_void_p, c_size_t]
 
+# int gattlib_get_handle_from_uuid(gattlib_connection_t* connection, const uuid_t* uuid, uint16_t* handle);
+gattlib_get_handle_from_uuid = gattlib.gattlib_get_handle_from_uuid
+gattlib_get_handle_from_uuid.argtypes = [c_void_p, POINTER(GattlibUuid), POINTER(c_uint16)]
+
 # int gattlib_write_without_response_char_by_uuid(gattlib_connection_t* connection, uuid_t* uuid, const void* buffer, size_t buffer_len)
 gattlib_write_without_response_char_by_uuid = gattlib.gattlib_write_without_response_char_by_uuid
 gattlib_write_without_response_char_by_uuid.argtypes = [c_void_p, POINTER(GattlibUuid), c_void_p, c_size_t]
@@ -211,10 +215,22 @@ gattlib_write_char_by_uuid_stream_open.argtypes = [c_void_p, POINTER(GattlibUuid
 gattlib_notification_start = gattlib.gattlib_notification_start
 gattlib_notification_start.argtypes = [c_void_p, POINTER(GattlibUuid)]
 
+# int gattlib_notification_start_with_handler(gattlib_connection_t* connection, const uuid_t* uuid, gattlib_event_handler_t notification_handler, void* user_data);
+gattlib_notification_start_with_handler = gattlib.gattlib_notification_start_with_handler
+gattlib_notification_start_with_handler.argtypes = [c_void_p, POINTER(GattlibUuid), c_void_p, c_void_p]
+
+# int gattlib_notification_start_acquired(gattlib_connection_t* connection, const uuid_t* uuid, gattlib_event_handler_t notification_handler, void* user_data);
+gattlib_notification_start_acquired = gattlib.gattlib_notification_start_acquired
+gattlib_notification_start_acquired.argtypes = [c_void_p, POINTER(GattlibUuid), c_void_p, c_void_p]
+
 # int gattlib_notification_stop(gattlib_connection_t* connection, const uuid_t* uuid);
 gattlib_notification_stop = gattlib.gattlib_notification_stop
 gattlib_notification_stop.argtypes = [c_void_p, POINTER(GattlibUuid)]
 
+# int gattlib_notification_wait_ready(gattlib_connection_t* connection, const uuid_t* uuid, unsigned int timeout_ms);
+gattlib_notification_wait_ready = gattlib.gattlib_notification_wait_ready
+gattlib_notification_wait_ready.argtypes = [c_void_p, POINTER(GattlibUuid), c_uint]
+
 # int gattlib_register_notification(gattlib_connection_t* connection, gattlib_event_handler_t notification_handler, void* user_data);
 gattlib_register_notification = gattlib.gattlib_register_notification
 gattlib_register_notification.argtypes = [c_void_p, c_void_p, c_void_p]
@@ -183,6 +183,15 @@ typedef void (*gattlib_event_handler_t)(const uuid_t* uuid, const uint8_t* data,
  */
 typedef void (*gattlib_disconnection_handler_t)(gattlib_connection_t* connection, void* user_data);
 
+/**
+ * @brief Handler called when notifications are effectively enabled on a GATT characteristic
+ *
+ * @param connection Connection of the GATT characteristic
+ * @param uuid       UUID of the GATT characteristic
+ * @param user_data  Data defined when calling `gattlib_notification_on_ready()`
+ */
+typedef void (*gattlib_notification_ready_handler_t)(gattlib_connection_t* connection, const uuid_t* uuid, void* user_data);
+
 /**
  * @brief Handler called on new discovered BLE device
  *
@@ -341,6 +350,21 @@ int gattlib_adapter_scan_eddystone(gattlib_adapter_t* adapter, int16_t rssi_thre
  */
 int gattlib_adapter_scan_disable(gattlib_adapter_t* adapter);
 
+/**
+ * @brief Register a device that is already known by the adapter
+ *
+ * Bluez keeps the devices discovered by previous scans (and paired devices) in its object manager.
+ * When the device is already known, it is registered so gattlib_connect() can be called
+ * straight away without scanning for it first.
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param mac_address is the Bluetooth address of the device
+ *
+ * @return GATTLIB_SUCCESS when the device can be connected, GATTLIB_NOT_FOUND when the device
+ *         must be discovered first or GATTLIB_* error code
+ */
+int gattlib_adapter_register_known_device(gattlib_adapter_t* adapter, const char *mac_address);
+
 /**
  * @brief Close Bluetooth adapter context
  *
@@ -544,6 +568,20 @@ int gattlib_write_char_by_uuid(gattlib_connection_t* connection, uuid_t* uuid, c
  */
 int gattlib_write_char_by_handle(gattlib_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len);
 
+/**
+ * @brief Function to get the handle of a GATT characteristic from its UUID
+ *
+ * The GATT characteristics of a connection are resolved once after service discovery. The returned handle
+ * can be passed to the `gattlib_*_by_handle()` functions of the same backend without any further lookup.
+ *
+ * @param connection Active GATT connection
+ * @param uuid UUID of the GATT characteristic
+ * @param handle is the returned handle of the GATT characteristic
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_NOT_FOUND if the characteristic is unknown or GATTLIB_* error code
+ */
+int gattlib_get_handle_from_uuid(gattlib_connection_t* connection, const uuid_t* uuid, uint16_t* handle);
+
 /**
  * @brief Function to write without response to the GATT characteristic UUID
  *
@@ -605,6 +643,8 @@ int gattlib_write_without_response_char_by_handle(gattlib_connection_t* connecti
 /*
  * @brief Enable notification on GATT characteristic represented by its UUID
  *
+ * The notifications are passed to the handler registered with gattlib_register_notification().
+ *
  * @param connection Active GATT connection
  * @param uuid UUID of the characteristic that will trigger the notification
  *
@@ -612,9 +652,57 @@ int gattlib_write_without_response_char_by_handle(gattlib_connection_t* connecti
  */
 int gattlib_notification_start(gattlib_connection_t* connection, const uuid_t* uuid);
 
+/*
+ * @brief Enable notification on GATT characteristic with a handler dedicated to this characteristic
+ *
+ * The characteristic is resolved once when the notifications are started. Its notifications are then
+ * routed to 'notification_handler' without parsing their UUID. They are not passed to the handler
+ * registered with gattlib_register_notification() nor to the batch handler. When the notification ring
+ * is enabled, they are queued in the ring and passed to 'notification_handler' one by one, in order
+ * with the other notifications of the connection.
+ *
+ * The handler is called in the same conditions as the handler of gattlib_register_notification().
+ *
+ * @param connection Active GATT connection
+ * @param uuid UUID of the characteristic that will trigger the notification
+ * @param notification_handler is the handler to call on notification. NULL to use the connection handler
+ *        (same as gattlib_notification_start()).
+ * @param user_data is the user specific data to pass to the handler
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_NOT_SUPPORTED if the characteristic cannot have its own
+ *         handler (eg: Battery Level, or any characteristic with the legacy Bluez backend) or GATTLIB_* error code.
+ *         The caller can then fall back on gattlib_register_notification() and gattlib_notification_start().
+ */
+int gattlib_notification_start_with_handler(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_event_handler_t notification_handler, void* user_data);
+
+/*
+ * @brief Enable notification on GATT characteristic through a dedicated socket
+ *
+ * With Bluez v5.48 and later, the notifications are read from the socket returned by 'AcquireNotify'
+ * instead of the D-Bus 'PropertiesChanged' signals. It saves the D-Bus marshalling for every notification.
+ * It falls back on gattlib_notification_start_with_handler() when Bluez cannot give the socket (eg: the characteristic
+ * only supports indications or another client has already enabled its notifications).
+ *
+ * The notifications are disabled with gattlib_notification_stop().
+ *
+ * @param connection Active GATT connection
+ * @param uuid UUID of the characteristic that will trigger the notification
+ * @param notification_handler is the handler of the characteristic (see gattlib_notification_start_with_handler())
+ *        or NULL to use the connection handler
+ * @param user_data is the user specific data to pass to the handler
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_notification_start_acquired(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_event_handler_t notification_handler, void* user_data);
+
 /*
  * @brief Disable notification on GATT characteristic represented by its UUID
  *
+ * No new notification of the characteristic is queued once it returns. The notifications already
+ * queued to the notification thread pool or ring might still be passed to the handler.
+ *
  * @param connection Active GATT connection
  * @param uuid UUID of the characteristic that will trigger the notification
  *
@@ -622,6 +710,40 @@ int gattlib_notification_start(gattlib_connection_t* connection, const uuid_t* u
  */
 int gattlib_notification_stop(gattlib_connection_t* connection, const uuid_t* uuid);
 
+/**
+ * @brief Register a handler called once notifications are effectively enabled on a GATT characteristic
+ *
+ * gattlib_notification_start() must have been called first. With the D-Bus backend, notifications are
+ * enabled when Bluez sets the 'Notifying' property of the characteristic (ie: the CCCD has been written).
+ * The handler is called only once. It is called immediately if notifications are already enabled.
+ *
+ * @param connection Active GATT connection
+ * @param uuid UUID of the characteristic that will trigger the notification
+ * @param ready_handler is the handler to call when notifications are enabled
+ * @param user_data is the user specific data to pass to the handler
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_NOT_FOUND if notifications have not been started or GATTLIB_* error code
+ */
+int gattlib_notification_on_ready(gattlib_connection_t* connection, const uuid_t* uuid,
+		gattlib_notification_ready_handler_t ready_handler, void* user_data);
+
+/**
+ * @brief Wait until notifications are effectively enabled on a GATT characteristic
+ *
+ * gattlib_notification_start() must have been called first.
+ *
+ * @note Do not call this function from the thread running the GLib main loop (eg: from the connection
+ *       callback). The property change would never be dispatched. Use gattlib_notification_on_ready() instead.
+ *
+ * @param connection Active GATT connection
+ * @param uuid UUID of the characteristic that will trigger the notification
+ * @param timeout_ms is the maximum time to wait in milliseconds
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_TIMEOUT if notifications are still not enabled after timeout_ms,
+ *         GATTLIB_NOT_FOUND if notifications have not been started or GATTLIB_* error code
+ */
+int gattlib_notification_wait_ready(gattlib_connection_t* connection, const uuid_t* uuid, unsigned int timeout_ms);
+
 /*
  * @brief Enable indication on GATT characteristic represented by its UUID
  *
@@ -645,6 +767,10 @@ int gattlib_indication_stop(gattlib_connection_t* connection, const uuid_t* uuid
 /*
  * @brief Register a handle for the GATT notifications
  *
+ * The handler is called from a gattlib worker thread without the gattlib global lock held. Handlers of
+ * different connections run concurrently; handlers of the same connection are serialised. The handler
+ * may call the other gattlib functions.
+ *
  * @param connection Active GATT connection
  * @param notification_handler is the handler to call on notification
  * @param user_data if the user specific data to pass to the handler
@@ -664,6 +790,88 @@ int gattlib_register_notification(gattlib_connection_t* connection, gattlib_even
  */
 int gattlib_register_indication(gattlib_connection_t* connection, gattlib_event_handler_t indication_handler, void* user_data);
 
+/**
+ * Statistics of the notification ring of a connection
+ */
+typedef struct {
+	size_t capacity;       //< Number of notifications the ring can hold
+	size_t high_water;     //< Highest number of notifications queued at once
+	uint64_t dispatched;   //< Notifications passed to the handler
+	uint64_t dropped;      //< Notifications dropped because the ring was full
+} gattlib_notification_ring_stats_t;
+
+/*
+ * @brief Dispatch the notifications of the connection through a lock-free ring
+ *
+ * By default notifications are passed to the handler registered with gattlib_register_notification()
+ * through a GLib thread pool. With a ring, each notification is copied into a bounded
+ * single-producer/single-consumer ring and a thread dedicated to the connection calls the handler.
+ * In both cases the handler runs without the gattlib global mutex, while the device is referenced
+ * and with the handler lock of the connection held: handlers of the same connection are serialised
+ * with each other and with gattlib_register_notification(), and the handler may call the other
+ * gattlib functions.
+ * When the ring is full, new notifications are dropped and counted.
+ * Notifications of a characteristic started with its own handler (gattlib_notification_start_with_handler())
+ * also go through the ring and are counted in its statistics.
+ *
+ * The ring is stopped when the connection is disconnected.
+ *
+ * @param connection Active GATT connection
+ * @param capacity Number of notifications the ring can hold (rounded up to a power of two)
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_notification_enable_ring(gattlib_connection_t* connection, size_t capacity);
+
+/*
+ * @brief Get the statistics of the notification ring of the connection
+ *
+ * @param connection Active GATT connection
+ * @param stats Statistics of the ring
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_NOT_FOUND if the connection does not use a ring
+ */
+int gattlib_notification_get_ring_stats(gattlib_connection_t* connection, gattlib_notification_ring_stats_t* stats);
+
+/**
+ * Notification passed to a batch handler
+ */
+typedef struct {
+	const uuid_t* uuid;       //< UUID of the characteristic
+	uint64_t timestamp_ns;    //< Reception time (CLOCK_MONOTONIC)
+	const uint8_t* data;
+	size_t data_length;
+} gattlib_notification_t;
+
+/**
+ * Handler called with a batch of notifications
+ *
+ * The notifications and their data are only valid until the handler returns.
+ */
+typedef void (*gattlib_notification_batch_handler_t)(gattlib_connection_t* connection,
+		const gattlib_notification_t* notifications, size_t count, void* user_data);
+
+/*
+ * @brief Register a handler receiving the GATT notifications in batches
+ *
+ * Notifications are queued in a ring (see gattlib_notification_enable_ring()) and a thread dedicated
+ * to the connection passes all the queued notifications to the handler at once, up to `max_batch`.
+ * When fewer notifications are queued, the thread waits until the oldest one has been queued for
+ * `max_latency_us` before calling the handler with a partial batch.
+ *
+ * It replaces the handler registered with gattlib_register_notification() for this connection.
+ *
+ * @param connection Active GATT connection
+ * @param handler is the handler to call with the notifications
+ * @param user_data if the user specific data to pass to the handler
+ * @param max_batch Maximum number of notifications passed in one call
+ * @param max_latency_us Maximum time a notification waits for the batch to fill, 0 to never wait
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_register_notification_batch(gattlib_connection_t* connection, gattlib_notification_batch_handler_t handler, void* user_data,
+		size_t max_batch, unsigned int max_latency_us);
+
 #if 0 // Disable until https://github.com/labapart/gattlib/issues/75 is resolved
 /**
  * @brief Function to retrieve RSSI from a GATT connection
@@ -0,0 +1,76 @@
+// 发送节奏测试：不连接设备，模拟写入耗时，检查实际速率和间隔抖动
+// 编译: gcc -O2 -o pacer_bench pacer_bench.c ble_pacer.c -lm
+// 用法: ./pacer_bench
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "ble_pacer.h"
+
+#define DATA_LEN 72
+
+// 忙等模拟一次写入的耗时
+static void busy_us(int us) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000L + (now.tv_nsec - start.tv_nsec) / 1000 < us);
+}
+
+// 返回实际速率与目标的相对误差
+static double run(const char* name, ble_pacer_unit_t unit, double rate, double burst, int sends, int write_us) {
+    ble_pacer_t pacer;
+    ble_pacer_report_t report;
+
+    ble_pacer_init(&pacer, unit, rate, burst);
+    for (int i = 0; i < sends; i++) {
+        ble_pacer_wait(&pacer, DATA_LEN);
+        // 写入耗时在0~2倍之间波动
+        busy_us(write_us ? rand() % (2 * write_us) : 0);
+    }
+    ble_pacer_report(&pacer, &report);
+
+    double error = fabs(report.rate - rate) / rate;
+    printf("  %-24s 目标%8.1f 实际%8.1f %s  间隔 %8.1f±%6.1f us  唤醒延迟 平均%5.1f 最大%6.1f us\n",
+           name, rate, report.rate, (unit == BLE_PACER_BYTES) ? "字节/秒" : "包/秒",
+           report.interval_mean_us, report.interval_jitter_us, report.late_mean_us, report.late_max_us);
+    return error;
+}
+
+int main(void) {
+    double worst = 0, error;
+
+    srand(1);
+    printf("每包%d字节:\n", DATA_LEN);
+    error = run("200包/秒", BLE_PACER_PACKETS, 200, 1, 400, 0);
+    worst = (error > worst) ? error : worst;
+    error = run("200包/秒 写入1ms", BLE_PACER_PACKETS, 200, 1, 400, 1000);
+    worst = (error > worst) ? error : worst;
+    error = run("14400字节/秒 写入1ms", BLE_PACER_BYTES, 14400, DATA_LEN, 400, 1000);
+    worst = (error > worst) ? error : worst;
+    error = run("1000包/秒", BLE_PACER_PACKETS, 1000, 1, 2000, 0);
+    worst = (error > worst) ? error : worst;
+
+    // 突发：前burst个包不等待，之后按速率发送
+    ble_pacer_t pacer;
+    ble_pacer_init(&pacer, BLE_PACER_PACKETS, 10, 5);
+    for (int i = 0; i < 5; i++) {
+        ble_pacer_wait(&pacer, DATA_LEN);
+    }
+    ble_pacer_report_t report;
+    ble_pacer_report(&pacer, &report);
+    printf("  突发5包用时 %.1f us，休眠%lu次\n", report.elapsed_sec * 1e6, (unsigned long)pacer.sleeps);
+    if (pacer.sleeps != 0) {
+        fprintf(stderr, "突发量内的发送不应等待\n");
+        return 1;
+    }
+
+    printf("最大速率误差 %.2f%%\n", worst * 100);
+    // 突发量为1时唤醒晚于一个周期的部分无法补回，负载高的机器上允许稍大的误差
+    if (worst > 0.05) {
+        fprintf(stderr, "实际速率偏离目标超过5%%\n");
+        return 1;
+    }
+    return 0;
+}
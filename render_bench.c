@@ -0,0 +1,237 @@
+// 文字渲染正确性与性能测试
+// 编译: gcc -O2 -o render_bench render_bench.c ble_render.c -lpthread
+// 用法: ./render_bench [HZK16 ASC16]，不指定字库时生成随机点阵的临时字库
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "ble_render.h"
+
+#define HZK16_LEN (94 * 94 * BLE_GLYPH_FULL_BYTES)
+#define ASC16_LEN (256 * BLE_GLYPH_HALF_BYTES)
+#define MESSAGES 20000
+#define BATCH 64
+
+// 常用汉字 (均在GB2312中)，与ASCII混合组成测试消息
+static const char* const m_hanzi[] = {
+    "的", "一", "是", "在", "不", "了", "有", "和", "人", "这", "中", "大", "为", "上", "个", "国",
+    "我", "以", "要", "他", "时", "来", "用", "们", "生", "到", "作", "地", "于", "出", "就", "分",
+    "对", "成", "会", "可", "主", "发", "年", "动", "同", "工", "也", "能", "下", "过", "子", "说",
+    "产", "种", "面", "而", "方", "后", "多", "定", "行", "学", "法", "所", "民", "得", "经", "十",
+    "三", "之", "进", "着", "等", "部", "度", "家", "电", "力", "里", "如", "水", "化", "高", "自",
+    "二", "理", "起", "小", "物", "现", "实", "加", "量", "都", "两", "体", "制", "机", "当", "使",
+    "欢", "迎", "光", "临", "今", "日", "特", "价", "元", "折", "满", "减", "新", "品", "，", "！",
+};
+#define HANZI_COUNT (sizeof(m_hanzi) / sizeof(m_hanzi[0]))
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 生成随机点阵字库文件
+static int write_random_font(char* path, size_t len) {
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return -1;
+    }
+    uint8_t* data = malloc(len);
+    if (data == NULL) {
+        close(fd);
+        return -1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)rand();
+    }
+    ssize_t written = write(fd, data, len);
+    free(data);
+    close(fd);
+    return (written == (ssize_t)len) ? 0 : -1;
+}
+
+static const uint8_t* read_file(const char* path, size_t* len) {
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    *len = (size_t)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t* data = malloc(*len);
+    if (data && fread(data, 1, *len, fp) != *len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    return data;
+}
+
+// 逐像素比较：字库逐行点阵 (高位在左) 与渲染结果逐列分页点阵 (低位在上)
+static int compare_glyph(const uint8_t* rows, int width, const uint8_t* columns) {
+    int row_bytes = width / 8;
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < width; x++) {
+            int expected = (rows[y * row_bytes + x / 8] >> (7 - x % 8)) & 1;
+            int actual = (columns[(y / 8) * width + x] >> (y % 8)) & 1;
+            if (expected != actual) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int verify(ble_font_t* font, const uint8_t* hzk16, const uint8_t* asc16) {
+    ble_render_msg_t msg;
+
+    // "中" 的GB2312编码为 D6D0
+    if (ble_render_text(font, "A中b", &msg) != 3 || msg.char_len != 3 ||
+        msg.type_list[0] != BLE_GLYPH_HALF || msg.type_list[1] != BLE_GLYPH_FULL ||
+        msg.type_list[2] != BLE_GLYPH_HALF ||
+        msg.data_len != 2 * BLE_GLYPH_HALF_BYTES + BLE_GLYPH_FULL_BYTES) {
+        fprintf(stderr, "字符数或类型列表错误\n");
+        return 1;
+    }
+    size_t zhong = ((0xD6 - 0xA1) * 94 + (0xD0 - 0xA1)) * BLE_GLYPH_FULL_BYTES;
+    if (compare_glyph(asc16 + 'A' * BLE_GLYPH_HALF_BYTES, 8, msg.data) != 0 ||
+        compare_glyph(hzk16 + zhong, 16, msg.data + BLE_GLYPH_HALF_BYTES) != 0 ||
+        compare_glyph(asc16 + 'b' * BLE_GLYPH_HALF_BYTES, 8, msg.data + BLE_GLYPH_HALF_BYTES + BLE_GLYPH_FULL_BYTES) != 0) {
+        fprintf(stderr, "点阵转换错误\n");
+        return 1;
+    }
+
+    // 超过16个字符时截断，consumed指向下一个字符
+    const char* text = "0123456789abcdefXYZ";
+    if (ble_render_text(font, text, &msg) != BLE_RENDER_MAX_CHARS || strcmp(text + msg.consumed, "XYZ") != 0) {
+        fprintf(stderr, "长文字截断错误\n");
+        return 1;
+    }
+
+    // GB2312以外的字符和非法UTF-8显示为'?'
+    if (ble_render_text(font, "\xF0\x9F\x98\x80\xFF", &msg) != 2 ||
+        compare_glyph(asc16 + '?' * BLE_GLYPH_HALF_BYTES, 8, msg.data) != 0 ||
+        compare_glyph(asc16 + '?' * BLE_GLYPH_HALF_BYTES, 8, msg.data + BLE_GLYPH_HALF_BYTES) != 0) {
+        fprintf(stderr, "未知字符处理错误\n");
+        return 1;
+    }
+    return 0;
+}
+
+// 随机消息：4~16个字符，约3/4为汉字
+static void make_messages(char (*texts)[BLE_RENDER_MAX_CHARS * 4 + 1], size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        char* p = texts[i];
+        int chars = 4 + rand() % (BLE_RENDER_MAX_CHARS - 3);
+        for (int c = 0; c < chars; c++) {
+            if (rand() % 4 != 0) {
+                const char* hanzi = m_hanzi[rand() % HANZI_COUNT];
+                size_t len = strlen(hanzi);
+                memcpy(p, hanzi, len);
+                p += len;
+            } else {
+                *p++ = (char)('!' + rand() % 94);
+            }
+        }
+        *p = '\0';
+    }
+}
+
+static void bench(const char* name, const char* hzk16_path, const char* asc16_path, size_t cache_size,
+                  const char* const* texts, ble_render_msg_t* msgs, bool batch) {
+    ble_font_t* font = ble_font_open(hzk16_path, asc16_path, cache_size);
+    if (font == NULL) {
+        return;
+    }
+
+    double start = now_sec();
+    for (size_t i = 0; i < MESSAGES; i += BATCH) {
+        size_t count = (MESSAGES - i < BATCH) ? MESSAGES - i : BATCH;
+        if (batch) {
+            ble_render_batch(font, texts + i, count, msgs);
+        } else {
+            for (size_t j = 0; j < count; j++) {
+                ble_render_text(font, texts[i + j], &msgs[j]);
+            }
+        }
+    }
+    double elapsed = now_sec() - start;
+
+    ble_render_stats_t stats;
+    ble_render_get_stats(font, &stats);
+    printf("  %-20s 缓存%-5zu %8.0f 条/秒 %7.1f ns/字  命中率 %5.1f%%\n",
+           name, cache_size, MESSAGES / elapsed, elapsed * 1e9 / stats.glyphs,
+           100.0 * (stats.glyphs - stats.misses) / stats.glyphs);
+    ble_font_close(font);
+}
+
+int main(int argc, char* argv[]) {
+    char hzk16_tmp[] = "/tmp/hzk16_XXXXXX";
+    char asc16_tmp[] = "/tmp/asc16_XXXXXX";
+    const char* hzk16_path;
+    const char* asc16_path;
+    bool generated = false;
+
+    srand(1);
+    if (argc == 3) {
+        hzk16_path = argv[1];
+        asc16_path = argv[2];
+    } else if (argc == 1) {
+        if (write_random_font(hzk16_tmp, HZK16_LEN) != 0 || write_random_font(asc16_tmp, ASC16_LEN) != 0) {
+            fprintf(stderr, "无法生成临时字库\n");
+            return 1;
+        }
+        hzk16_path = hzk16_tmp;
+        asc16_path = asc16_tmp;
+        generated = true;
+    } else {
+        printf("用法: %s [HZK16 ASC16]\n", argv[0]);
+        return 1;
+    }
+
+    size_t hzk16_len, asc16_len;
+    const uint8_t* hzk16 = read_file(hzk16_path, &hzk16_len);
+    const uint8_t* asc16 = read_file(asc16_path, &asc16_len);
+    ble_font_t* font = ble_font_open(hzk16_path, asc16_path, 0);
+    int ret = 1;
+    if (hzk16 == NULL || asc16 == NULL || font == NULL) {
+        fprintf(stderr, "无法打开字库\n");
+        goto EXIT;
+    }
+    if (verify(font, hzk16, asc16) != 0) {
+        goto EXIT;
+    }
+    printf("正确性校验通过\n");
+
+    char (*texts)[BLE_RENDER_MAX_CHARS * 4 + 1] = malloc(MESSAGES * sizeof(*texts));
+    const char** text_ptrs = malloc(MESSAGES * sizeof(char*));
+    ble_render_msg_t* msgs = malloc(BATCH * sizeof(ble_render_msg_t));
+    if (texts == NULL || text_ptrs == NULL || msgs == NULL) {
+        goto EXIT;
+    }
+    make_messages(texts, MESSAGES);
+    for (size_t i = 0; i < MESSAGES; i++) {
+        text_ptrs[i] = texts[i];
+    }
+
+    printf("%d条消息，每批%d条:\n", MESSAGES, BATCH);
+    bench("逐条渲染", hzk16_path, asc16_path, 16, text_ptrs, msgs, false);
+    bench("逐条渲染", hzk16_path, asc16_path, BLE_RENDER_CACHE_SIZE, text_ptrs, msgs, false);
+    bench("批量渲染", hzk16_path, asc16_path, BLE_RENDER_CACHE_SIZE, text_ptrs, msgs, true);
+    free(texts);
+    free(text_ptrs);
+    free(msgs);
+    ret = 0;
+
+EXIT:
+    ble_font_close(font);
+    free((void*)hzk16);
+    free((void*)asc16);
+    if (generated) {
+        unlink(hzk16_tmp);
+        unlink(asc16_tmp);
+    }
+    return ret;
+}
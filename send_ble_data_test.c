@@ -2,11 +2,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <pthread.h>
 #include <glib.h>
 #include <gattlib.h>
 #include <stdint.h>
 #include <time.h>
+#include "ble_checksum.h"
 
 // 协议常量定义
 #define CMD_A0 0xA0
@@ -35,22 +37,13 @@ static struct {
     int success_count;
     int fail_count;
     bool last_send_success;     // 上一次发送结果
-    uint8_t* last_packet;       // 上一次发送的数据包
-    size_t last_packet_len;     // 上一次发送的数据包长度
     bool waiting_feedback;      // 是否等待反馈
 } m_state;
 
-// 全局变量：标记是否发现目标设备
+// 全局变量：标记是否发现目标设备 (由m_state.lock保护)
 static bool device_found = false;
-// 校验和计算函数
-static uint16_t calculate_checksum(const uint8_t* data, size_t len) {
-    uint16_t sum = 0;
-    for (size_t i = 0; i < len; i++) {
-        sum += data[i];
-    }
-    return sum; // 取低16位作为校验和
-}
-
+// 发送特征句柄，连接后解析一次 (0表示未解析，按UUID写入)
+static uint16_t m_char_handle = 0;
 // 数据包打印函数
 static void print_packet(const uint8_t* data, size_t len) {
     printf("Packet (len: %zu): ", len);
@@ -72,7 +65,7 @@ static size_t build_a0_packet(uint8_t gear, uint8_t* buffer, size_t buffer_len)
     buffer[1] = gear;
     
     // 计算校验和
-    uint16_t checksum = calculate_checksum(buffer, 2);
+    uint16_t checksum = ble_checksum(buffer, 2);
     buffer[2] = (checksum >> 8) & 0xFF;  // 高8位
     buffer[3] = checksum & 0xFF;         // 低8位
 
@@ -94,7 +87,7 @@ static size_t build_a1_packet(uint8_t play_mode, uint8_t total_lists,
     buffer[5] = current_effect;
     
     // 计算校验和
-    uint16_t checksum = calculate_checksum(buffer, 6);
+    uint16_t checksum = ble_checksum(buffer, 6);
     buffer[6] = (checksum >> 8) & 0xFF;
     buffer[7] = checksum & 0xFF;
 
@@ -116,7 +109,7 @@ static size_t build_a2_packet(uint16_t total_bytes, uint8_t total_packets,
     memcpy(buffer + 5, type_list, 16);      // 类型列表
     
     // 计算校验和
-    uint16_t checksum = calculate_checksum(buffer, 4 + 16);
+    uint16_t checksum = ble_checksum(buffer, 4 + 16);
     buffer[21] = (checksum >> 8) & 0xFF;    // 5+16=21
     buffer[22] = checksum & 0xFF;
 
@@ -135,7 +128,7 @@ static size_t build_a3_packet(uint8_t current_packet, uint8_t current_len,
     memcpy(buffer + 3, data, 64);  // 数据段(固定64字节)
     
     // 计算校验和
-    uint16_t checksum = calculate_checksum(data, 64);
+    uint16_t checksum = ble_checksum(data, 64);
     buffer[67] = (checksum >> 8) & 0xFF;    // 3+64=67
     buffer[68] = checksum & 0xFF;
 
@@ -208,36 +201,22 @@ static bool send_packet_with_retry(gattlib_connection_t* connection,
             return false;
         }
 
-        // 发送数据
-        int ret = gattlib_write_char_by_uuid(connection, &m_config.char_uuid, data, len);
+        // 发送数据，句柄已解析时直接按句柄写入
+        int ret;
+        if (m_char_handle != 0) {
+            ret = gattlib_write_char_by_handle(connection, m_char_handle, data, len);
+        } else {
+            ret = gattlib_write_char_by_uuid(connection, &m_config.char_uuid, data, len);
+        }
         if (ret != 0) {
             printf("发送失败 (错误码: %d)\n", ret);
-            
-            // 尝试使用句柄发送（从gattool日志看句柄是0x0023）
-            printf("尝试使用句柄发送...\n");
-            ret = gattlib_write_char_by_handle(connection, 0x0023, data, len);
-            if (ret != 0) {
-                printf("句柄发送也失败 (错误码: %d)\n", ret);
-                retries++;
-                continue;
-            } else {
-                printf("使用句柄发送成功\n");
-            }
-        } else {
-            printf("使用UUID发送成功\n");
+            retries++;
+            continue;
         }
         // 等待反馈
         pthread_mutex_lock(&m_state.lock);
         m_state.waiting_feedback = true;
         m_state.last_send_success = false;
-        
-        // 缓存当前包用于重发
-        free(m_state.last_packet);
-        m_state.last_packet = malloc(len);
-        if (m_state.last_packet) {
-            memcpy(m_state.last_packet, data, len);
-            m_state.last_packet_len = len;
-        }
 
         // 设置超时
         struct timespec ts;
@@ -344,8 +323,6 @@ static void on_connect(gattlib_adapter_t* adapter, const char* dst,
         return;
     } else {
         printf("已启动通知监听，等待设备反馈...\n");
-        // 关键：等待一小段时间确保通知完全启用
-        usleep(500000);  // 等待500ms，让设备准备就绪
     }
     pthread_mutex_lock(&m_state.lock);
     m_state.connection = connection;
@@ -380,6 +357,18 @@ static void send_continuous_data() {
     gattlib_connection_t* connection = m_state.connection;
     pthread_mutex_unlock(&m_state.lock);
 
+    // 等待CCCD写入完成(通知真正启用)后再发第一帧
+    int ret = gattlib_notification_wait_ready(connection, &m_config.notify_uuid, 3000);
+    if (ret != 0) {
+        fprintf(stderr, "等待通知启用失败: %d，继续发送\n", ret);
+    }
+
+    // 发送特征的句柄在服务发现后解析一次，之后的写入和重发都按句柄进行
+    if (gattlib_get_handle_from_uuid(connection, &m_config.char_uuid, &m_char_handle) != GATTLIB_SUCCESS) {
+        m_char_handle = 0;
+        printf("未解析到发送特征句柄，按UUID写入\n");
+    }
+
     // 示例1: 发送A0包 (调速，档位3)
     printf("\n===== 发送A0包 =====");
     uint8_t a0_buffer[4];
@@ -453,22 +442,31 @@ static void send_continuous_data() {
 
 
 
-// 扫描回调函数：发现目标设备后停止扫描并连接
+// 标记已发现目标设备并发起连接，唤醒等待扫描结果的主任务
+static void start_connect(gattlib_adapter_t* adapter) {
+    pthread_mutex_lock(&m_state.lock);
+    bool already_found = device_found;
+    device_found = true;
+    pthread_cond_broadcast(&m_state.cond);
+    pthread_mutex_unlock(&m_state.lock);
+    if (already_found) {
+        return;
+    }
+
+    // 发起连接
+    printf("正在连接设备 %s...\n", m_config.mac_address);
+    int ret = gattlib_connect(adapter, m_config.mac_address, 
+                        GATTLIB_CONNECTION_OPTIONS_NONE, on_connect, NULL);
+    if (ret != 0) {
+        fprintf(stderr, "连接请求失败: %d\n", ret);
+    }
+}
+
+// 扫描回调函数：发现目标设备后立即连接
 static void ble_discovered_device(gattlib_adapter_t* adapter, const char* addr, const char* name, void* user_data) {
     if (strcasecmp(addr, m_config.mac_address) == 0) {
         printf("发现目标设备: %s\n", addr);
-        device_found = true;
-        gattlib_adapter_scan_disable(adapter); // 停止扫描
-
-        // 发起连接
-        printf("正在连接设备 %s...\n", m_config.mac_address);
-        int ret = gattlib_connect(adapter, m_config.mac_address, 
-                            GATTLIB_CONNECTION_OPTIONS_NONE, on_connect, NULL);
-        if (ret != 0) {
-            fprintf(stderr, "连接请求失败: %d\n", ret);
-            gattlib_adapter_close(adapter);
-            return;
-        }
+        start_connect(adapter);
     }
 }
 
@@ -485,22 +483,38 @@ static void* ble_task(void* arg) {
         return NULL;
     }
 
-    // 开始扫描设备（超时30秒）
-    printf("正在扫描设备 %s...\n", m_config.mac_address);
-    ret = gattlib_adapter_scan_enable(adapter, ble_discovered_device, 30, NULL);
-    if (ret != 0) {
-        fprintf(stderr, "扫描失败: %d\n", ret);
-        gattlib_adapter_close(adapter);
-        return NULL;
-    }
+    if (gattlib_adapter_register_known_device(adapter, m_config.mac_address) == GATTLIB_SUCCESS) {
+        // BlueZ已记录该设备，直接连接
+        printf("设备 %s 已知，直接连接\n", m_config.mac_address);
+        start_connect(adapter);
+    } else {
+        // 开始扫描设备（超时30秒），扫描不阻塞，发现设备时回调立即连接并唤醒这里
+        printf("正在扫描设备 %s...\n", m_config.mac_address);
+        ret = gattlib_adapter_scan_enable_with_filter_non_blocking(adapter, NULL, 0,
+                GATTLIB_DISCOVER_FILTER_USE_NONE, ble_discovered_device, 30, NULL);
+        if (ret != 0) {
+            fprintf(stderr, "扫描失败: %d\n", ret);
+            gattlib_adapter_close(adapter);
+            return NULL;
+        }
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 30; // 最多等30秒
 
-    // 等待扫描发现设备
-    int scan_wait = 0;
-    while (!device_found && scan_wait < 30) { // 最多等30秒
-        g_usleep(1000000); // 每秒检查一次
-        scan_wait++;
+        pthread_mutex_lock(&m_state.lock);
+        int wait_ret = 0;
+        while (!device_found && wait_ret != ETIMEDOUT) {
+            wait_ret = pthread_cond_timedwait(&m_state.cond, &m_state.lock, &deadline);
+        }
+        pthread_mutex_unlock(&m_state.lock);
+        gattlib_adapter_scan_disable(adapter);
     }
-    if (!device_found) {
+
+    pthread_mutex_lock(&m_state.lock);
+    bool found = device_found;
+    pthread_mutex_unlock(&m_state.lock);
+    if (!found) {
         fprintf(stderr, "30秒内未发现目标设备\n");
         gattlib_adapter_close(adapter);
         return NULL;
@@ -543,8 +557,6 @@ int main(int argc, char* argv[]) {
     m_state.success_count = 0;
     m_state.fail_count = 0;
     m_state.last_send_success = false;
-    m_state.last_packet = NULL;
-    m_state.last_packet_len = 0;
     m_state.waiting_feedback = false;
     device_found = false;
 
@@ -574,7 +586,6 @@ int main(int argc, char* argv[]) {
            m_state.success_count + m_state.fail_count);
 
     // 清理资源
-    free(m_state.last_packet);
     pthread_mutex_destroy(&m_state.lock);
     pthread_cond_destroy(&m_state.cond);
 
@@ -0,0 +1,114 @@
+// 统计模块正确性与性能测试：直方图分位数误差、滑动窗口吞吐量、记录开销
+// 编译: gcc -O2 -o stats_bench stats_bench.c ble_stats.c
+// 用法: ./stats_bench
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "ble_stats.h"
+
+#define SAMPLES 1000000
+
+static int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// 对数正态分布的延迟样本 (中位数约2ms，带长尾)
+static uint64_t random_latency(void) {
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double z = sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+    return (uint64_t)exp(log(2000) + 0.8 * z);
+}
+
+static int check_percentiles(void) {
+    static ble_hist_t hist;
+    uint64_t* values = malloc(SAMPLES * sizeof(uint64_t));
+    if (values == NULL) {
+        return 1;
+    }
+
+    ble_hist_init(&hist);
+    for (int i = 0; i < SAMPLES; i++) {
+        values[i] = random_latency();
+        ble_hist_record(&hist, values[i]);
+    }
+    qsort(values, SAMPLES, sizeof(uint64_t), cmp_u64);
+
+    // 直方图返回桶上界，与精确值的相对误差不超过1/64
+    const double ps[] = { 50, 90, 99, 99.9, 100 };
+    int ret = 0;
+    for (size_t i = 0; i < sizeof(ps) / sizeof(ps[0]); i++) {
+        size_t rank = (size_t)ceil(ps[i] / 100.0 * SAMPLES);
+        uint64_t exact = values[rank - 1];
+        uint64_t approx = ble_hist_percentile(&hist, ps[i]);
+        double error = fabs((double)approx - (double)exact) / (double)exact;
+        printf("  p%-5g 精确 %8lu  直方图 %8lu  误差 %.2f%%\n",
+               ps[i], (unsigned long)exact, (unsigned long)approx, error * 100);
+        if (approx < exact || error > 1.0 / 64) {
+            ret = 1;
+        }
+    }
+    if (hist.min != values[0] || hist.max != values[SAMPLES - 1]) {
+        ret = 1;
+    }
+    free(values);
+    if (ret != 0) {
+        fprintf(stderr, "分位数误差超出范围\n");
+    }
+    return ret;
+}
+
+// 每10ms写入100字节 (10000字节/秒)，中间停顿2秒
+static int check_windows(void) {
+    static ble_stats_t stats;
+    int64_t t = 1000000000LL;
+
+    ble_stats_init(&stats, 0);
+    for (int i = 0; i < 500; i++, t += 10000000LL) {
+        ble_stats_record_write(&stats, t, t + 1000000LL, 100, 0, true);
+    }
+    t += 2000000000LL;
+    for (int i = 0; i < 500; i++, t += 10000000LL) {
+        ble_stats_record_write(&stats, t, t + 1000000LL, 100, i % 10 == 0, i % 50 != 0);
+    }
+    ble_stats_print(&stats, stdout);
+    ble_stats_write_json(&stats, "stats_bench \"window\"", stdout);
+
+    if (stats.rate.windows == 0 || stats.rate.min_bps != 0 ||
+        fabs(stats.rate.max_bps - 10000) > 10000 * 0.02 || stats.retries != 50 || stats.failures != 10) {
+        fprintf(stderr, "滑动窗口或计数错误\n");
+        return 1;
+    }
+    return 0;
+}
+
+static void bench_record(void) {
+    static ble_hist_t hist;
+    uint64_t* values = malloc(SAMPLES * sizeof(uint64_t));
+    if (values == NULL) {
+        return;
+    }
+    for (int i = 0; i < SAMPLES; i++) {
+        values[i] = random_latency();
+    }
+    ble_hist_init(&hist);
+    int64_t start = ble_stats_now_ns();
+    for (int i = 0; i < SAMPLES; i++) {
+        ble_hist_record(&hist, values[i]);
+    }
+    int64_t elapsed = ble_stats_now_ns() - start;
+    printf("记录 %.1f ns/个，直方图 %zu 字节\n", (double)elapsed / SAMPLES, sizeof(hist));
+    free(values);
+}
+
+int main(void) {
+    srand(1);
+    printf("分位数 (%d个对数正态样本):\n", SAMPLES);
+    if (check_percentiles() != 0 || check_windows() != 0) {
+        return 1;
+    }
+    bench_record();
+    printf("正确性校验通过\n");
+    return 0;
+}
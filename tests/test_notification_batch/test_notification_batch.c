@@ -0,0 +1,203 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2024  Olivier Martin <olivier@labapart.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Check a batch handler registered on its own receives the notifications
+ *
+ * Only gattlib_register_notification_batch() is called, gattlib_register_notification() is not.
+ * The device must send notifications on the given characteristic during the test.
+ */
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#ifdef GATTLIB_LOG_BACKEND_SYSLOG
+#include <syslog.h>
+#endif
+
+#include "gattlib.h"
+
+#define BLE_SCAN_TIMEOUT          10
+#define NOTIFICATION_WAIT_SEC     10
+#define BATCH_MAX                 8
+#define BATCH_MAX_LATENCY_US      10000
+
+static struct {
+	const char* adapter_name;
+	const char* mac_address;
+	uuid_t notification_uuid;
+} m_argument;
+
+static struct {
+	pthread_cond_t condition;
+	pthread_mutex_t lock;
+	bool value;
+} m_connection_terminated = { PTHREAD_COND_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, false };
+
+static struct {
+	unsigned long calls;
+	unsigned long notifications;
+	bool bad_batch;
+} m_result;
+
+static void batch_handler(gattlib_connection_t* connection, const gattlib_notification_t* notifications, size_t count, void* user_data) {
+	if ((count == 0) || (count > BATCH_MAX)) {
+		m_result.bad_batch = true;
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (gattlib_uuid_cmp(notifications[i].uuid, &m_argument.notification_uuid) != 0) {
+			m_result.bad_batch = true;
+		}
+	}
+
+	__atomic_add_fetch(&m_result.calls, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&m_result.notifications, count, __ATOMIC_RELAXED);
+}
+
+static void on_device_connect(gattlib_adapter_t* adapter, const char *dst, gattlib_connection_t* connection, int error, void* user_data) {
+	int ret;
+
+	if (error != 0) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to connect to device '%s': Error %d", m_argument.mac_address, error);
+		goto TERMINATE;
+	}
+
+	ret = gattlib_register_notification_batch(connection, batch_handler, NULL, BATCH_MAX, BATCH_MAX_LATENCY_US);
+	if (ret != GATTLIB_SUCCESS) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to register the batch handler: %d", ret);
+		goto EXIT;
+	}
+
+	ret = gattlib_notification_start(connection, &m_argument.notification_uuid);
+	if (ret != GATTLIB_SUCCESS) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to start notification: %d", ret);
+		goto EXIT;
+	}
+
+	GATTLIB_LOG(GATTLIB_INFO, "Wait for notifications for %d seconds...", NOTIFICATION_WAIT_SEC);
+	g_usleep(NOTIFICATION_WAIT_SEC * G_USEC_PER_SEC);
+
+	gattlib_notification_stop(connection, &m_argument.notification_uuid);
+
+EXIT:
+	gattlib_disconnect(connection, true /* wait_disconnection */);
+
+TERMINATE:
+	pthread_mutex_lock(&m_connection_terminated.lock);
+	m_connection_terminated.value = true;
+	pthread_cond_signal(&m_connection_terminated.condition);
+	pthread_mutex_unlock(&m_connection_terminated.lock);
+}
+
+static int stricmp(char const *a, char const *b) {
+    for (;; a++, b++) {
+        int d = tolower((unsigned char)*a) - tolower((unsigned char)*b);
+        if (d != 0 || !*a)
+            return d;
+    }
+}
+
+static void ble_discovered_device(gattlib_adapter_t* adapter, const char* addr, const char* name, void *user_data) {
+	int ret;
+
+	if (stricmp(addr, m_argument.mac_address) != 0) {
+		return;
+	}
+
+	GATTLIB_LOG(GATTLIB_INFO, "Found bluetooth device '%s'", m_argument.mac_address);
+
+	ret = gattlib_connect(adapter, addr, GATTLIB_CONNECTION_OPTIONS_NONE, on_device_connect, NULL);
+	if (ret != GATTLIB_SUCCESS) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to connect to the bluetooth device '%s': %d", addr, ret);
+		return;
+	}
+
+	// Wait for the test to complete
+	pthread_mutex_lock(&m_connection_terminated.lock);
+	while (!m_connection_terminated.value) {
+		pthread_cond_wait(&m_connection_terminated.condition, &m_connection_terminated.lock);
+	}
+	pthread_mutex_unlock(&m_connection_terminated.lock);
+}
+
+static void* ble_task(void* arg) {
+	gattlib_adapter_t* adapter;
+	int ret;
+
+	ret = gattlib_adapter_open(m_argument.adapter_name, &adapter);
+	if (ret) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to open adapter.");
+		return NULL;
+	}
+
+	ret = gattlib_adapter_scan_enable(adapter, ble_discovered_device, BLE_SCAN_TIMEOUT, NULL /* user_data */);
+	if (ret) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to scan.");
+	}
+	gattlib_adapter_scan_disable(adapter);
+
+	gattlib_adapter_close(adapter);
+	return NULL;
+}
+
+int main(int argc, const char *argv[]) {
+	int ret;
+
+	if (argc == 3) {
+		m_argument.adapter_name = NULL;
+		m_argument.mac_address = argv[1];
+	} else if (argc == 4) {
+		m_argument.adapter_name = argv[1];
+		m_argument.mac_address = argv[2];
+	} else {
+		printf("%s [<bluetooth-adapter>] <mac_address> <notification_characteristic_uuid>\n", argv[0]);
+		return 1;
+	}
+
+	if (gattlib_string_to_uuid(argv[argc - 1], strlen(argv[argc - 1]) + 1, &m_argument.notification_uuid) < 0) {
+		printf("Invalid UUID '%s'\n", argv[argc - 1]);
+		return 1;
+	}
+
+#ifdef GATTLIB_LOG_BACKEND_SYSLOG
+	openlog("gattlib_test_notification_batch", LOG_CONS | LOG_NDELAY | LOG_PERROR, LOG_USER);
+	setlogmask(LOG_UPTO(LOG_INFO));
+#endif
+
+	ret = gattlib_mainloop(ble_task, NULL);
+	if (ret != GATTLIB_SUCCESS) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to create gattlib mainloop");
+		return 1;
+	}
+
+	printf("Batch handler: %lu calls, %lu notifications\n", m_result.calls, m_result.notifications);
+	if ((m_result.calls == 0) || m_result.bad_batch) {
+		printf("FAILED\n");
+		return 1;
+	}
+	return 0;
+}